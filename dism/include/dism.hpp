@@ -1,7 +1,9 @@
 #pragma once
 
+#include "bytecode.hpp"
 #include <sstream>
 #include <string>
+#include <vector>
 namespace ripl {
 class Dism {
 public:
@@ -15,9 +17,11 @@ public:
   std::string readString();
 
   void disassemble();
+  void disassemble(const RegisterCode &registers);
 
 private:
   int _ip = 0;
   std::stringstream _buf;
+  std::vector<std::string> _pool; // the constant pool
 };
 } // namespace ripl
@@ -1,5 +1,7 @@
 #include "dism.hpp"
+#include "bytecode.hpp"
 #include "instruction_set.hpp"
+#include "register_set.hpp"
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -22,7 +24,27 @@ ripl::Dism::Dism(char *filename) {
 ripl::Dism::~Dism() { _buf.clear(); }
 
 void ripl::Dism::disassemble() {
-  for (_ip = 0; !_buf.eof(); _ip++) {
+  std::string image = _buf.str();
+  BytecodeHeader header;
+  if (!ripl::readHeader(image.data(), image.length(), header)) {
+    std::cerr << "Not a bytecode file of version " << BYTECODE_VERSION << "."
+              << std::endl;
+    return;
+  }
+  std::cout << "Version " << header.version << ", " << header.slots
+            << " slots" << std::endl;
+
+  for (auto s : ripl::readPool(image.data(), image.length(), header)) {
+    _pool.push_back(std::string(s));
+  }
+  std::cout << "Constant pool (" << _pool.size() << " entries):" << std::endl;
+  for (int i = 0; i < _pool.size(); i++) {
+    std::cout << "  " << i << " \"" << _pool[i] << "\"" << std::endl;
+  }
+
+  std::cout << "Code:" << std::endl;
+  _buf.seekg(sizeof(header));
+  for (_ip = sizeof(header); _ip < header.poolOffset; _ip++) {
     char c;
     _buf.get(c);
     Instruction mnemonic = (Instruction)c;
@@ -46,10 +68,10 @@ void ripl::Dism::disassemble() {
       _ip += sizeof(l);
     } break;
     case Instruction::PUSHS: {
-      std::string l = readString();
-      std::cout << _ip << " " << "PUSHS \"" << l << "\"" << std::endl;
+      int index = readInt();
+      std::cout << _ip << " " << "PUSHS " << index << " \"" << _pool[index]
+                << "\"" << std::endl;
       _ip += sizeof(int);
-      _ip += l.length();
     } break;
     case Instruction::ADD: {
       std::cout << _ip << " ADD" << std::endl;
@@ -163,10 +185,185 @@ void ripl::Dism::disassemble() {
     case Instruction::PRINT: {
       std::cout << _ip << " PRINT" << std::endl;
     } break;
+    case Instruction::ADDLL: {
+      std::cout << _ip << " ADDLL" << std::endl;
+    } break;
+    case Instruction::ADDDD: {
+      std::cout << _ip << " ADDDD" << std::endl;
+    } break;
+    case Instruction::SUBLL: {
+      std::cout << _ip << " SUBLL" << std::endl;
+    } break;
+    case Instruction::SUBDD: {
+      std::cout << _ip << " SUBDD" << std::endl;
+    } break;
+    case Instruction::MULLL: {
+      std::cout << _ip << " MULLL" << std::endl;
+    } break;
+    case Instruction::MULDD: {
+      std::cout << _ip << " MULDD" << std::endl;
+    } break;
+    case Instruction::DIVLL: {
+      std::cout << _ip << " DIVLL" << std::endl;
+    } break;
+    case Instruction::DIVDD: {
+      std::cout << _ip << " DIVDD" << std::endl;
+    } break;
+    case Instruction::CONCAT: {
+      std::cout << _ip << " CONCAT" << std::endl;
+    } break;
+    case Instruction::EQLL: {
+      std::cout << _ip << " EQLL" << std::endl;
+    } break;
+    case Instruction::NEQLL: {
+      std::cout << _ip << " NEQLL" << std::endl;
+    } break;
+    case Instruction::GTLL: {
+      std::cout << _ip << " GTLL" << std::endl;
+    } break;
+    case Instruction::LTLL: {
+      std::cout << _ip << " LTLL" << std::endl;
+    } break;
+    case Instruction::GTELL: {
+      std::cout << _ip << " GTELL" << std::endl;
+    } break;
+    case Instruction::LTELL: {
+      std::cout << _ip << " LTELL" << std::endl;
+    } break;
+    case Instruction::LOADSLOT: {
+      int slot = readInt();
+      std::cout << _ip << " " << "LOADSLOT " << slot << std::endl;
+      _ip += sizeof(int);
+    } break;
+    case Instruction::STORESLOT: {
+      int slot = readInt();
+      std::cout << _ip << " " << "STORESLOT " << slot << std::endl;
+      _ip += sizeof(int);
+    } break;
+    case Instruction::DUPJZ: {
+      int addrparm = readInt();
+      std::cout << _ip << " DUPJZ " << addrparm << std::endl;
+      _ip += sizeof(int);
+    } break;
+    case Instruction::DECJNZ: {
+      int addrparm = readInt();
+      std::cout << _ip << " DECJNZ " << addrparm << std::endl;
+      _ip += sizeof(int);
+    } break;
+    case Instruction::ADDL: {
+      long l = readLong();
+      std::cout << _ip << " " << "ADDL " << l << std::endl;
+      _ip += sizeof(l);
+    } break;
+    case Instruction::ADDSLOTLL: {
+      int slot = readInt();
+      std::cout << _ip << " " << "ADDSLOTLL " << slot << std::endl;
+      _ip += sizeof(int);
+    } break;
+    case Instruction::TAILCALL: {
+      int addrparm = readInt();
+      std::cout << _ip << " " << "TAILCALL " << addrparm << std::endl;
+      _ip += sizeof(int);
+    } break;
     case Instruction::END: {
       std::cout << _ip << " END" << std::endl;
     } break;
+    case Instruction::HALT: {
+      std::cout << _ip << " HALT" << std::endl;
+    } break;
+    }
+  }
+
+  RegisterCode registers;
+  if (ripl::readRegisterCode(image.data(), image.length(), header,
+                             registers)) {
+    disassemble(registers);
+  }
+}
+
+// Registers are shown as r<number>. Where the stack code may take over the
+// offset it carries on at and the registers making up its stack follow.
+void ripl::Dism::disassemble(const RegisterCode &registers) {
+  std::cout << "Register code (" << registers.registers
+            << " registers):" << std::endl;
+  const char *code = registers.code.data();
+  int pos = 0;
+  auto read = [&](auto &value) {
+    std::memcpy((char *)&value, code + pos, sizeof(value));
+    pos += sizeof(value);
+  };
+  while (pos < registers.code.length()) {
+    int start = pos;
+    auto instruction = (RegisterInstruction)code[pos++];
+    int end = start + sizeOf(instruction);
+    std::cout << start << " " << mnemonic(instruction);
+
+    // the registers come first, then an operand of what is left.
+    int count = 0;
+    switch (instruction) {
+    case RegisterInstruction::LOADL:
+    case RegisterInstruction::LOADD:
+    case RegisterInstruction::LOADB:
+    case RegisterInstruction::LOADS:
+    case RegisterInstruction::JZ:
+    case RegisterInstruction::JF:
+    case RegisterInstruction::DECJNZ:
+    case RegisterInstruction::EXPECT:
+    case RegisterInstruction::PRINT:
+      count = 1;
+      break;
+    case RegisterInstruction::MOV:
+    case RegisterInstruction::NOT:
+    case RegisterInstruction::INC:
+    case RegisterInstruction::DEC:
+      count = 2;
+      break;
+    case RegisterInstruction::JMP:
+    case RegisterInstruction::END:
+    case RegisterInstruction::DEOPT:
+    case RegisterInstruction::HALT:
+      break;
+    default:
+      count = 3;
+      break;
+    }
+    for (int i = 0; i < count; i++) {
+      unsigned short reg;
+      read(reg);
+      std::cout << (i == 0 ? " r" : ", r") << reg;
+    }
+    if (instruction == RegisterInstruction::LOADL) {
+      long l;
+      read(l);
+      std::cout << ", " << l;
+    } else if (instruction == RegisterInstruction::LOADD) {
+      double d;
+      read(d);
+      std::cout << ", " << d;
+    } else if (instruction == RegisterInstruction::LOADB) {
+      bool b;
+      read(b);
+      std::cout << ", " << b;
+    } else if (instruction == RegisterInstruction::LOADS) {
+      int index;
+      read(index);
+      std::cout << ", \"" << _pool[index] << "\"";
+    } else if (pos < end) {
+      int operand;
+      read(operand);
+      std::cout << (count == 0 ? " " : ", ") << operand;
+    }
+
+    auto deopt = registers.deopts.find(start);
+    if (deopt != registers.deopts.end()) {
+      std::cout << "  ; stack code at " << deopt->second.offset << " [";
+      for (int i = 0; i < deopt->second.stack.size(); i++) {
+        std::cout << (i == 0 ? "r" : " r") << deopt->second.stack[i];
+      }
+      std::cout << "]";
     }
+    std::cout << std::endl;
+    pos = end;
   }
 }
 
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+namespace ripl {
+// Bump allocator for the strings created while a program runs. Memory comes
+// in blocks that are kept for the next run, reset makes all of it available
+// again at once instead of freeing what was allocated one by one.
+class Arena {
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  char *allocate(std::size_t size);
+  void reset();
+
+private:
+  std::vector<std::unique_ptr<char[]>> _blocks;
+  std::vector<std::unique_ptr<char[]>> _large; // bigger than a block each
+  std::size_t _used = 0; // blocks handed out from since the last reset
+  char *_next = nullptr;
+  char *_end = nullptr;
+};
+} // namespace ripl
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <string_view>
+#include <vector>
+namespace ripl {
+// Bumped whenever the instruction set or the layout of the file changes.
+const int BYTECODE_VERSION = 3;
+
+// Every .bc file starts with this header. The code follows right after it up
+// to the constant pool and always ends with a HALT. Jump and call addresses
+// are offsets from the start of the file.
+//
+// The constant pool holds the string constants of the program: an int count
+// followed by that many length prefixed strings. PUSHS refers to them by
+// their index.
+//
+// The register code, if there is any, comes after the pool: an int with the
+// number of registers, the int length of the code and the code itself (see
+// register_set.hpp), followed by an int count of deopts. Each of those is the
+// position in the register code it is for, the offset of the stack
+// instruction to carry on at, the int depth of the data stack there and the
+// register (an unsigned short) holding each of its values, bottom first.
+struct BytecodeHeader {
+  char magic[4]; // "RIPL"
+  int version;
+  int slots;          // number of variable slots used by the program
+  int poolOffset;     // where the code ends and the constant pool starts
+  int registerOffset; // where the register code starts, 0 if there is none
+};
+
+// Where the stack code takes over from the register code.
+struct Deopt {
+  int offset;                        // of the stack instruction to resume at
+  std::vector<unsigned short> stack; // the registers making up the data stack
+};
+
+struct RegisterCode {
+  int registers = 0;
+  std::string_view code;
+  std::map<int, Deopt> deopts; // by position in the code
+};
+
+BytecodeHeader makeHeader(int slots, int poolOffset, int registerOffset = 0);
+bool readHeader(const char *image, int length, BytecodeHeader &header);
+std::vector<std::string_view> readPool(const char *image, int length,
+                                       const BytecodeHeader &header);
+// False if there is no register code or it doesn't fit the image.
+bool readRegisterCode(const char *image, int length,
+                      const BytecodeHeader &header, RegisterCode &registers);
+} // namespace ripl
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "arena.hpp"
+#include "bytecode.hpp"
+#include "instruction_set.hpp"
+#include "jit.hpp"
+#include "line_reader.hpp"
+#include "mapped_file.hpp"
+#include "profiler.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace ripl {
+// Runs a compiled program. The bytecode is loaded once and can then be run
+// any number of times, every run starts out with empty stacks and all
+// variables back at 0 while reusing the memory of the previous one.
+//
+// Input for EXPECT, the output of PRINT and error messages go to cin, cout
+// and cerr unless other streams are set. EXPECT can also read its lines
+// straight from text in memory, see setInput.
+//
+// Programs compiled with riplc --registers run their register code, the stack
+// code takes over whenever it can't go on.
+class Engine {
+public:
+  Engine(const char *filename, bool map = true);
+  // Runs the image in place, it has to outlive the engine.
+  Engine(const char *image, std::size_t length);
+  ~Engine();
+
+  bool isLoaded() { return _code != nullptr; }
+  void setStreams(std::istream &in, std::ostream &out,
+                  std::ostream &err = std::cerr);
+  void setInput(std::string_view text) { _input.setText(text); }
+
+  void run();
+  void reset();               // done by every run, releases runtime strings
+  void profile(bool listing); // report where run spends its time on err
+  bool jit(); // compile to machine code where supported, see Jit
+  void useStackCode() { _stackOnly = true; } // ignore any register code
+
+  template <typename T> T read();           // To read any kind of value
+  template <typename T> void push(T value); // To push any value on _ds
+
+  // Applies an arithmetic operator to the top two values, replacing them with
+  // the result. Leaves the stack untouched if they are not both numbers.
+  template <typename Op> bool tryOperate(Op operate);
+  template <typename Op> void compare(Op op);
+
+  template <typename T> std::pair<bool, T> fetch() {
+    const Value &value = _ds.back();
+    if (value.is<T>()) {
+      T result = value.as<T>();
+      _ds.pop_back();
+      return std::make_pair(true, result);
+    }
+    return std::make_pair(false, T());
+  }
+
+private:
+  friend class Jit;
+
+  // An instruction of the stack code as decode() lays it out once at load
+  // time, so running it never parses bytes: the operand is ready to use and
+  // jumps point at the instruction they go to.
+  struct Decoded {
+    void *handler; // where the run loop handles it, threaded dispatch only
+    Instruction instruction;
+    int offset; // in the image, for the profiler and error messages
+    union {
+      long l;
+      double d;
+      bool b;
+      const Value *constant; // PUSHS
+      Value *variable;
+      const Decoded *target; // jumps and CALL
+    };
+  };
+
+  template <bool Profile> void execute();
+  void executeRegisters();
+  bool deopt(const char *pc);
+  void start();
+  Value input();
+  void print(const Value &value);
+  void end(std::size_t stackSize); // the report of END
+  void write(std::string_view text);
+  void flush();
+  std::ostream &error(); // _err, once the output so far is written
+  void load(const char *image, int length, const char *name);
+  bool decode(const BytecodeHeader &header, const char *name);
+  bool verifyRegisters(const BytecodeHeader &header, const char *name);
+  const Decoded *decoded(int offset) { return &_decoded[_index[offset]]; }
+
+  std::unique_ptr<MappedFile> _image; // only when loaded from a file
+  int _codeLen = 0;
+  const char *_code = nullptr;
+  const char *_ip; // where execute starts, in the image
+  std::vector<Decoded> _decoded;
+  std::vector<int> _index; // offset in the image -> index in _decoded
+  void *_handlers = nullptr; // the loop the handlers of _decoded are in
+  std::vector<Value> _ds;
+  std::vector<Value> _variables;      // indexed by slot, all start out as 0
+  // The return stack has room for RS_SIZE nested calls, running out of it
+  // stops the program. Tail calls don't take up any.
+  static constexpr int RS_SIZE = 1 << 20;
+  std::unique_ptr<const Decoded *[]> _rs;
+  int _rsDepth = 0;
+  std::unique_ptr<Profiler> _profiler; // only while profiling
+  bool _listing = false;
+  std::unique_ptr<Jit> _jit; // only once compiled
+  RegisterCode _registerCode;
+  std::vector<Value> _registers; // variables first, indexed by slot
+  bool _stackOnly = false;
+
+  LineReader _input;
+  std::ostream *_out = &std::cout;
+  std::ostream *_err = &std::cerr;
+  std::string _output; // printed but not yet written to _out
+
+  std::vector<Value> _pool; // the constant pool, pointing into the image
+  Arena _arena;             // the strings created while running
+  Value string(std::string_view chars);
+
+  Value pop() {
+    Value value = _ds.back();
+    _ds.pop_back();
+    return value;
+  }
+};
+} // namespace ripl
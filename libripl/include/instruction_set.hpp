@@ -15,6 +15,8 @@ enum class Instruction : unsigned char {
   AND,     // logical AND
   OR,      // logical or
   NOT,     // logical NOT
+  // The comparisons always pop both operands and push a bool. Values of types
+  // that can't be compared with each other give false, for NEQ as well.
   EQ,      // equals
   NEQ,     // not equals
   GT,      // greater than
@@ -25,9 +27,9 @@ enum class Instruction : unsigned char {
   JF,      // jump on false
   JMP,     // jump
   ID,      // identifier
-  VAR,     // variable declaration
-  ASSIGN,  // assignment
-  DEREF,   // Dereference a variable
+  VAR,     // variable declaration (no longer emitted, see LOADSLOT)
+  ASSIGN,  // assignment (no longer emitted, see STORESLOT)
+  DEREF,   // Dereference a variable (no longer emitted, see LOADSLOT)
   CALL,    // call subroutine
   RET,     // return
   DUP,     // Duplicate the top item
@@ -39,7 +41,38 @@ enum class Instruction : unsigned char {
   DEC,     // decrement the top
   EXPECT,  // wait for user input
   PRINT,   // Print the top of the stack
+  // Type-specialized forms of the arithmetic and comparison instructions,
+  // emitted by the compiler when it can prove the types of both operands.
+  ADDLL,  // long + long
+  ADDDD,  // double + double
+  SUBLL,  // long - long
+  SUBDD,  // double - double
+  MULLL,  // long * long
+  MULDD,  // double * double
+  DIVLL,  // long / long, yields a double
+  DIVDD,  // double / double
+  CONCAT, // string + string
+  EQLL,   // long == long
+  NEQLL,  // long != long
+  GTLL,   // long > long
+  LTLL,   // long < long
+  GTELL,  // long >= long
+  LTELL,  // long <= long
+  // Variables are resolved to slots by the compiler.
+  LOADSLOT,  // push the value of a variable slot
+  STORESLOT, // pop the top into a variable slot
+  // Superinstructions, each doing the work of a common sequence at once.
+  DUPJZ,     // DUP JZ, the head of a for loop
+  DECJNZ,    // DEC and jump back to the loop body unless the count hit 0
+  ADDL,      // PUSHL ADDLL, adds the long operand to the top
+  ADDSLOTLL, // LOADSLOT ADDLL, adds the value of a slot to the top
+  TAILCALL,  // CALL RET, goes to the subroutine without a return address
   // add more instructions here...
+  HALT = 254, // stop silently, placed after the last instruction by riplc
   END = 255,
 };
+
+// The name of the instruction as shown by dism and the profiler.
+const char *mnemonic(Instruction instruction);
+int sizeOf(Instruction instruction); // opcode plus operand bytes
 } // namespace ripl
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "instruction_set.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <map>
+#include <vector>
+#if defined(__x86_64__) && defined(__linux__)
+#define RIPL_HAVE_JIT
+#endif
+namespace ripl {
+class Engine;
+
+// A baseline JIT that translates the whole program into x86-64 machine code
+// by stitching together a pre-assembled template for every instruction.
+// Subroutines become native functions, CALL and RET native calls and
+// returns. The generic instructions that need the full promotion rules
+// (ADD, comparisons, PRINT, ...) call out to small C++ thunks.
+//
+// Instructions it has no template for, as well as running out of data or
+// return stack, hand the program back to the interpreter: the stacks are
+// copied over to the engine and it carries on at that instruction.
+//
+// Only available on x86-64 Linux, isCompiled() is false everywhere else.
+class Jit {
+public:
+  enum class Exit : int {
+    HALT = 0,
+    END,
+    BAIL, // the interpreter has to take over at Engine::_ip
+  };
+
+  Jit(Engine &engine);
+  ~Jit();
+
+  Jit(const Jit &) = delete;
+  Jit &operator=(const Jit &) = delete;
+
+  bool isCompiled() { return _entry != nullptr; }
+  Exit run();
+
+  // What the compiled code runs with, it lives in rbx while running.
+  struct Context {
+    Engine *engine;
+    Value *sp;        // next free entry of the data stack, r12
+    Value *limit;     // end of the data stack, r13
+    Value *variables; // r14
+    int *rs;          // next free entry of the return stack, r15
+    int *rsBase;
+    int *rsLimit;
+    void *savedRsp;
+    int bail; // offset the interpreter continues at
+  };
+
+private:
+  typedef int (*Entry)(Context *context);
+
+  Engine &_engine;
+  Entry _entry = nullptr;
+  void *_memory = nullptr;
+  std::size_t _size = 0;
+  std::vector<Value> _stack;
+  std::vector<int> _returns;
+  Context _context;
+
+  // code generation
+  std::vector<unsigned char> _code;
+  std::map<int, int> _labels;              // bytecode offset -> code
+  std::vector<std::pair<int, int>> _jumps; // rel32 position -> offset
+  std::vector<std::pair<int, int>> _bails; // rel32 position -> offset
+  int _exit = 0;  // where the code leaves, with the Exit in eax
+  int _start = 0; // the entry point
+
+  bool compile();
+  bool translate(int offset, int next);
+  void bytes(std::initializer_list<unsigned char> code);
+  template <typename T> void operand(T value);
+  void jump(unsigned char opcode, int offset);
+  void jumpIf(int condition, int offset);
+  void bailIf(int condition, int offset);
+  int forward(int condition);
+  void bind(int position);
+  void checkOverflow(int offset);
+  void move(unsigned char opcode, int reg, int base, int displacement);
+  void copy(int toBase, int to, int fromBase, int from);
+  void type(int displacement, ValueType type);
+  void push(ValueType type, long bits);
+  void push(const Value &value);
+  void thunk(Value *(*function)(Context *, Value *));
+  void status(Exit exit);
+  bool install();
+
+  // generic instructions, they return the new top of the data stack.
+  static Value *add(Context *context, Value *sp);
+  template <typename Op, Instruction instruction>
+  static Value *arithmetic(Context *context, Value *sp);
+  template <typename Op> static Value *compare(Context *context, Value *sp);
+  static Value *mod(Context *context, Value *sp);
+  template <bool And> static Value *logic(Context *context, Value *sp);
+  static Value *negate(Context *context, Value *sp);
+  static Value *concat(Context *context, Value *sp);
+  static Value *print(Context *context, Value *sp);
+  static Value *expect(Context *context, Value *sp);
+};
+} // namespace ripl
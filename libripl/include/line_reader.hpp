@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <istream>
+#include <string_view>
+#include <vector>
+namespace ripl {
+// Hands out the lines EXPECT reads, of any length, without the newline. A
+// stream is read in large chunks, std::cin straight from standard input so
+// a chunk is whatever is there (a line typed at a terminal, a whole buffer
+// of a file). Chars already in memory are handed out in place.
+class LineReader {
+public:
+  LineReader(std::istream &in = std::cin) { setStream(in); }
+
+  void setStream(std::istream &in);
+  void setText(std::string_view text); // has to outlive the reader's use
+
+  // The line stays valid until the next call, false at the end of input.
+  bool next(std::string_view &line);
+
+private:
+  std::istream *_stream = nullptr;
+  bool _standardInput = false;
+  bool _end = false; // nothing left to read, only what's buffered
+  std::vector<char> _buffer;
+  const char *_next = nullptr; // of the chars not handed out yet
+  const char *_last = nullptr;
+
+  void fill();
+};
+} // namespace ripl
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+namespace ripl {
+// Read-only view of a whole file. Where possible the file is memory mapped
+// and used in place, otherwise (or when mapping is not wanted) it is read
+// into a buffer in one shot.
+class MappedFile {
+public:
+  MappedFile(const char *filename, bool map = true);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool isOpen() { return _data != nullptr; }
+  bool isMapped() { return _mapped; }
+  const char *data() { return _data; }
+  std::size_t length() { return _length; }
+
+private:
+  const char *_data = nullptr;
+  std::size_t _length = 0;
+  bool _mapped = false;
+
+  bool _map(const char *filename);
+  bool _read(const char *filename);
+};
+} // namespace ripl
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+namespace ripl {
+// Collects what Engine::run spends its time on when profiling is switched
+// on. Every instruction is charged the ticks from its own dispatch to the
+// dispatch of the one after it. Ticks are TSC cycles on x86-64 and
+// nanoseconds everywhere else.
+class Profiler {
+public:
+  Profiler(int codeLength);
+
+  void step(int offset, unsigned char opcode); // about to execute an opcode
+  void enter(int address);                     // CALL to a subroutine
+  void leave();                                // RET from it
+  void finish();
+
+  void report(std::ostream &out, bool listing);
+
+private:
+  struct Counter {
+    std::uint64_t count = 0;
+    std::uint64_t ticks = 0;
+  };
+  struct Frame {
+    int address;
+    std::uint64_t start;
+  };
+
+  Counter _opcodes[256];
+  std::vector<Counter> _offsets;
+  std::vector<unsigned char> _opcodeAt; // the opcode seen at each offset
+  std::vector<Counter> _subroutines;    // by address, ticks include callees
+  std::vector<int> _active;             // activations of each subroutine
+  std::vector<Frame> _frames;
+
+  int _last = -1; // offset of the instruction being timed
+  std::uint64_t _start = 0;
+  std::uint64_t _total = 0;
+
+  void charge(std::uint64_t now);
+  static std::uint64_t ticks();
+};
+} // namespace ripl
@@ -0,0 +1,65 @@
+#pragma once
+
+namespace ripl {
+// The instructions of the register form of a program, which riplc
+// --registers writes next to the stack code. Every value lives in a register
+// of its own: the variables, the constants of the program and every position
+// of the data stack.
+//
+// Operands are register numbers (an unsigned short each) unless noted
+// otherwise, the first one is where the result goes. Whenever an instruction
+// comes across something the stack code would handle differently (an operand
+// of the wrong type, an error to report) it leaves the rest of the run to the
+// stack code instead, see RegisterCode.
+enum class RegisterInstruction : unsigned char {
+  MOV = 0, // a = b
+  LOADL,   // a = long operand
+  LOADD,   // a = double operand
+  LOADB,   // a = bool operand
+  LOADS,   // a = string, an int index into the constant pool
+  ADD,     // a = b + c
+  SUB,     // a = b - c
+  MUL,     // a = b * c
+  DIV,     // a = b / c
+  MOD,     // a = b % c
+  AND,     // a = b && c
+  OR,      // a = b || c
+  NOT,     // a = !b
+  EQ,      // a = b == c
+  NEQ,     // a = b != c
+  GT,      // a = b > c
+  LT,      // a = b < c
+  GTE,     // a = b >= c
+  LTE,     // a = b <= c
+  // Type-specialized forms, as in the stack code.
+  ADDLL,
+  ADDDD,
+  SUBLL,
+  SUBDD,
+  MULLL,
+  MULDD,
+  DIVLL,
+  DIVDD,
+  CONCAT,
+  EQLL,
+  NEQLL,
+  GTLL,
+  LTLL,
+  GTELL,
+  LTELL,
+  INC,    // a = b, plus one if it is a long
+  DEC,    // a = b, minus one if it is a long
+  JMP,    // jump to the int operand
+  JZ,     // jump to the int operand if a is a long 0
+  JF,     // jump to the int operand if a is false
+  DECJNZ, // decrement a, jump to the int operand unless it hit 0
+  EXPECT, // a = a line of input
+  PRINT,  // print a
+  DEOPT,  // carry on in the stack code
+  END,    // END of the stack code, the int operand is the stack size
+  HALT,
+};
+
+const char *mnemonic(RegisterInstruction instruction);
+int sizeOf(RegisterInstruction instruction); // opcode plus operand bytes
+} // namespace ripl
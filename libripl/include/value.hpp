@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <string_view>
+namespace ripl {
+class Arena;
+
+enum class ValueType : unsigned char {
+  LONG = 0,
+  DOUBLE,
+  BOOL,
+  STRING,
+};
+
+// A Value is what lives on the data stack and in variables. It is a small
+// tagged union that is copied around by value. Strings of up to SMALL chars
+// are held in the value itself, in the bytes after the type, longer ones
+// point at chars owned by whoever created the value (the constant pool, the
+// arena of the engine).
+struct Value {
+  static constexpr int SMALL = 14;
+
+  // Both layouts start with type and small, an inline string overlays the
+  // rest of the value with its chars.
+  struct Inline {
+    ValueType type;
+    unsigned char small;
+    char chars[SMALL];
+  };
+
+  union {
+    struct {
+      ValueType type;
+      unsigned char small; // the inline length of a string plus one, else 0
+      unsigned int length; // of a string that is not
+      union {
+        long l;
+        double d;
+        bool b;
+        const char *s;
+      };
+    };
+    Inline inlined;
+  };
+
+  Value() : type(ValueType::LONG), l(0) {}
+  explicit Value(long value) : type(ValueType::LONG), l(value) {}
+  explicit Value(double value) : type(ValueType::DOUBLE), d(value) {}
+  explicit Value(bool value) : type(ValueType::BOOL), b(value) {}
+  // Copies a short string in, a longer one has to outlive the value.
+  explicit Value(std::string_view value) : type(ValueType::STRING) {
+    if (value.size() <= SMALL) {
+      inlined.type = ValueType::STRING;
+      inlined.small = value.size() + 1;
+      std::memcpy(inlined.chars, value.data(), value.size());
+      return;
+    }
+    small = 0;
+    length = value.size();
+    s = value.data();
+  }
+
+  bool isNumeric() const {
+    return type == ValueType::LONG || type == ValueType::DOUBLE;
+  }
+  double toDouble() const { return type == ValueType::LONG ? l : d; }
+  std::string_view str() const {
+    return small != 0 ? std::string_view(inlined.chars, small - 1)
+                      : std::string_view(s, length);
+  }
+
+  template <typename T> bool is() const;
+  template <typename T> T as() const;
+};
+
+template <> inline bool Value::is<long>() const {
+  return type == ValueType::LONG;
+}
+template <> inline bool Value::is<double>() const {
+  return type == ValueType::DOUBLE;
+}
+template <> inline bool Value::is<bool>() const {
+  return type == ValueType::BOOL;
+}
+template <> inline bool Value::is<std::string>() const {
+  return type == ValueType::STRING;
+}
+
+template <> inline long Value::as<long>() const { return l; }
+template <> inline double Value::as<double>() const { return d; }
+template <> inline bool Value::as<bool>() const { return b; }
+template <> inline std::string Value::as<std::string>() const {
+  return std::string(str());
+}
+
+// The promotion rules of the VM: long op long stays long, as soon as one side
+// is a double both sides are treated as doubles. Returns false if either side
+// is not a number.
+template <typename Op>
+bool arithmetic(const Value &lhs, const Value &rhs, Op op, Value &result) {
+  if (lhs.type == ValueType::LONG && rhs.type == ValueType::LONG) {
+    result = Value(op(lhs.l, rhs.l));
+    return true;
+  }
+  if (lhs.isNumeric() && rhs.isNumeric()) {
+    result = Value(op(lhs.toDouble(), rhs.toDouble()));
+    return true;
+  }
+  return false;
+}
+
+// Comparisons follow the same promotion for numbers, strings compare with
+// strings and bools with bools. Anything else is simply false.
+template <typename Op> bool compare(const Value &lhs, const Value &rhs, Op op) {
+  if (lhs.type == ValueType::LONG && rhs.type == ValueType::LONG) {
+    return op(lhs.l, rhs.l);
+  }
+  if (lhs.isNumeric() && rhs.isNumeric()) {
+    return op(lhs.toDouble(), rhs.toDouble());
+  }
+  if (lhs.type == ValueType::STRING && rhs.type == ValueType::STRING) {
+    return op(lhs.str(), rhs.str());
+  }
+  if (lhs.type == ValueType::BOOL && rhs.type == ValueType::BOOL) {
+    return op(lhs.b, rhs.b);
+  }
+  return false;
+}
+
+// String concatenation done by ADD when at least one side is a string, the
+// other side may be a string or a number. Returns false otherwise. A result
+// too long to be held inline is allocated from arena.
+bool concatenate(const Value &lhs, const Value &rhs, Arena &arena,
+                 Value &result);
+} // namespace ripl
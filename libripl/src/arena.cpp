@@ -0,0 +1,31 @@
+#include "arena.hpp"
+#include <cstddef>
+#include <memory>
+
+#define ARENA_BLOCK 65536
+
+char *ripl::Arena::allocate(std::size_t size) {
+  if (size > (std::size_t)(_end - _next)) {
+    // what is left of the current block is given up, unless the request
+    // wouldn't fit in a fresh block either.
+    if (size > ARENA_BLOCK) {
+      _large.push_back(std::make_unique_for_overwrite<char[]>(size));
+      return _large.back().get();
+    }
+    if (_used == _blocks.size()) {
+      _blocks.push_back(std::make_unique_for_overwrite<char[]>(ARENA_BLOCK));
+    }
+    _next = _blocks[_used++].get();
+    _end = _next + ARENA_BLOCK;
+  }
+  char *chars = _next;
+  _next += size;
+  return chars;
+}
+
+// The blocks stay around, only the large allocations are given back.
+void ripl::Arena::reset() {
+  _large.clear();
+  _used = 0;
+  _next = _end = nullptr;
+}
@@ -0,0 +1,93 @@
+#include "bytecode.hpp"
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+static const char MAGIC[4] = {'R', 'I', 'P', 'L'};
+
+ripl::BytecodeHeader ripl::makeHeader(int slots, int poolOffset,
+                                      int registerOffset) {
+  BytecodeHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = BYTECODE_VERSION;
+  header.slots = slots;
+  header.poolOffset = poolOffset;
+  header.registerOffset = registerOffset;
+  return header;
+}
+
+bool ripl::readHeader(const char *image, int length, BytecodeHeader &header) {
+  if (length < (int)sizeof(BytecodeHeader)) {
+    return false;
+  }
+  std::memcpy((char *)&header, image, sizeof(BytecodeHeader));
+  return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+         header.version == BYTECODE_VERSION &&
+         header.poolOffset >= (int)sizeof(BytecodeHeader) &&
+         header.poolOffset + (int)sizeof(int) <= length;
+}
+
+// The returned views point straight into the image.
+std::vector<std::string_view> ripl::readPool(const char *image, int length,
+                                             const BytecodeHeader &header) {
+  std::vector<std::string_view> pool;
+  int pos = header.poolOffset;
+  int count;
+  std::memcpy((char *)&count, image + pos, sizeof(int));
+  pos += sizeof(int);
+  for (int i = 0; i < count && pos + (int)sizeof(int) <= length; i++) {
+    int len;
+    std::memcpy((char *)&len, image + pos, sizeof(int));
+    pos += sizeof(int);
+    if (pos + len > length) {
+      break;
+    }
+    pool.emplace_back(image + pos, len);
+    pos += len;
+  }
+  return pool;
+}
+
+bool ripl::readRegisterCode(const char *image, int length,
+                            const BytecodeHeader &header,
+                            RegisterCode &registers) {
+  int pos = header.registerOffset;
+  if (pos <= header.poolOffset) {
+    return false;
+  }
+  auto readInt = [&](int &value) {
+    if (pos + (int)sizeof(int) > length) {
+      return false;
+    }
+    std::memcpy((char *)&value, image + pos, sizeof(int));
+    pos += sizeof(int);
+    return true;
+  };
+
+  int codeLength, count;
+  if (!readInt(registers.registers) || !readInt(codeLength) ||
+      codeLength < 0 || pos + codeLength > length) {
+    return false;
+  }
+  registers.code = std::string_view(image + pos, codeLength);
+  pos += codeLength;
+  if (!readInt(count)) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    int at, depth;
+    Deopt deopt;
+    if (!readInt(at) || !readInt(deopt.offset) || !readInt(depth) ||
+        depth < 0 || pos + depth * (int)sizeof(unsigned short) > length) {
+      return false;
+    }
+    deopt.stack.resize(depth);
+    std::memcpy((char *)deopt.stack.data(), image + pos,
+                depth * sizeof(unsigned short));
+    pos += depth * sizeof(unsigned short);
+    registers.deopts[at] = std::move(deopt);
+  }
+  return true;
+}
@@ -0,0 +1,1424 @@
+#include "engine.hpp"
+#include "bytecode.hpp"
+#include "instruction_set.hpp"
+#include "jit.hpp"
+#include "profiler.hpp"
+#include "register_set.hpp"
+#include "value.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#define DS_SIZE 1024
+#define OUTPUT_SIZE 65536
+#define NUMBER_SIZE 32 // a long, or a double with six significant digits
+
+// The code is executed straight out of the file image, which is memory
+// mapped unless map is false or mapping is not possible.
+ripl::Engine::Engine(const char *filename, bool map)
+    : _image(std::make_unique<MappedFile>(filename, map)) {
+  if (!_image->isOpen()) {
+    std::cerr << "Could not open file " << filename << " for input."
+              << std::endl;
+    return;
+  }
+  load(_image->data(), _image->length(), filename);
+}
+
+ripl::Engine::Engine(const char *image, std::size_t length) {
+  load(image, length, "The image");
+}
+
+void ripl::Engine::load(const char *image, int length, const char *name) {
+  _ds.reserve(DS_SIZE);
+  // only the pages actually used are ever touched.
+  _rs = std::make_unique_for_overwrite<const Decoded *[]>(RS_SIZE);
+  _output.reserve(OUTPUT_SIZE);
+  _codeLen = length;
+
+  BytecodeHeader header;
+  if (!ripl::readHeader(image, _codeLen, header)) {
+    std::cerr << name << " is not a bytecode file of version "
+              << BYTECODE_VERSION << "." << std::endl;
+    return;
+  }
+  _code = image;
+
+  // the values of the constant pool are made once up front so PUSHS only
+  // has to copy one.
+  for (auto s : ripl::readPool(_code, _codeLen, header)) {
+    _pool.emplace_back(s);
+  }
+  _variables.resize(header.slots);
+  if (!decode(header, name)) {
+    _code = nullptr;
+    return;
+  }
+  if (ripl::readRegisterCode(_code, _codeLen, header, _registerCode) &&
+      verifyRegisters(header, name)) {
+    _registers.resize(_registerCode.registers);
+  } else {
+    _registerCode = RegisterCode();
+  }
+}
+
+// Every instruction from the header up to the pool is decoded, followed by a
+// HALT right where the pool starts should the code ever run off its end.
+// Jumps are resolved once all of them are in place. Operands that don't fit
+// in the code, jumps into the middle of an instruction and indexes out of
+// range fail the load instead of being run. Unknown opcodes are kept, the
+// run loop reports them once it gets to one.
+bool ripl::Engine::decode(const BytecodeHeader &header, const char *name) {
+  int start = sizeof(BytecodeHeader);
+  int end = header.poolOffset;
+  auto fail = [name](int offset) {
+    std::cerr << name << " has an invalid instruction at offset " << offset
+              << "." << std::endl;
+    return false;
+  };
+  _index.assign(end + 1, -1);
+  std::vector<std::pair<int, int>> jumps; // index in _decoded, target
+  for (int offset = start; offset < end;) {
+    Decoded instruction{};
+    instruction.instruction = (Instruction)_code[offset];
+    instruction.offset = offset;
+    int size = sizeOf(instruction.instruction);
+    if (offset + size > end) {
+      return fail(offset);
+    }
+    const char *operand = _code + offset + 1;
+    int index;
+    switch (instruction.instruction) {
+    case Instruction::PUSHL:
+    case Instruction::ADDL:
+      std::memcpy(&instruction.l, operand, sizeof(long));
+      break;
+    case Instruction::PUSHD:
+      std::memcpy(&instruction.d, operand, sizeof(double));
+      break;
+    case Instruction::PUSHB:
+      std::memcpy(&instruction.b, operand, sizeof(bool));
+      break;
+    case Instruction::PUSHS:
+      std::memcpy(&index, operand, sizeof(int));
+      if (index < 0 || index >= (int)_pool.size()) {
+        return fail(offset);
+      }
+      instruction.constant = &_pool[index];
+      break;
+    case Instruction::LOADSLOT:
+    case Instruction::STORESLOT:
+    case Instruction::ADDSLOTLL:
+      std::memcpy(&index, operand, sizeof(int));
+      if (index < 0 || index >= (int)_variables.size()) {
+        return fail(offset);
+      }
+      instruction.variable = &_variables[index];
+      break;
+    case Instruction::JZ:
+    case Instruction::JF:
+    case Instruction::JMP:
+    case Instruction::DUPJZ:
+    case Instruction::DECJNZ:
+    case Instruction::CALL:
+    case Instruction::TAILCALL:
+      std::memcpy(&index, operand, sizeof(int));
+      jumps.emplace_back(_decoded.size(), index);
+      break;
+    default:
+      break;
+    }
+    _index[offset] = _decoded.size();
+    _decoded.push_back(instruction);
+    offset += size;
+  }
+  _index[end] = _decoded.size();
+  _decoded.push_back(Decoded{nullptr, Instruction::HALT, end, {}});
+
+  for (auto [from, target] : jumps) {
+    if (target < start || target > end || _index[target] < 0) {
+      return fail(_decoded[from].offset);
+    }
+    _decoded[from].target = &_decoded[_index[target]];
+  }
+  return true;
+}
+
+// The register code is run without any checks, so it is only kept if every
+// register number is below the number of registers, every jump lands on an
+// instruction, the last one doesn't run off the end and every deopt leads
+// to a decoded instruction with a stack made up of registers. Otherwise the
+// stack code runs on its own, which is all the register code ever saves.
+bool ripl::Engine::verifyRegisters(const BytecodeHeader &header,
+                                   const char *name) {
+  const RegisterCode &registers = _registerCode;
+  std::string_view code = registers.code;
+  auto fail = [name](int at) {
+    std::cerr << name << " has invalid register code at " << at
+              << ", running the stack code instead." << std::endl;
+    return false;
+  };
+  // numbered by unsigned shorts, and the variables come first.
+  if (registers.registers < (int)_variables.size() ||
+      registers.registers > std::numeric_limits<unsigned short>::max() + 1) {
+    return fail(0);
+  }
+  auto isRegister = [&](const char *operand) {
+    unsigned short reg;
+    std::memcpy(&reg, operand, sizeof(reg));
+    return reg < registers.registers;
+  };
+
+  std::vector<bool> boundary(code.size() + 1, false);
+  std::vector<std::pair<int, int>> jumps; // at, target
+  auto last = RegisterInstruction::HALT;
+  for (int at = 0; at < code.size();) {
+    auto instruction = (RegisterInstruction)code[at];
+    int size = sizeOf(instruction);
+    if (instruction > RegisterInstruction::HALT ||
+        at + size > code.size()) {
+      return fail(at);
+    }
+    const char *operand = code.data() + at + 1;
+    const int reg = sizeof(unsigned short);
+    int regs = 0, value = 0;
+    switch (instruction) {
+    case RegisterInstruction::LOADL:
+    case RegisterInstruction::LOADD:
+    case RegisterInstruction::LOADB:
+    case RegisterInstruction::EXPECT:
+    case RegisterInstruction::PRINT:
+      regs = 1;
+      break;
+    case RegisterInstruction::LOADS:
+      regs = 1;
+      std::memcpy(&value, operand + reg, sizeof(int));
+      if (value < 0 || value >= (int)_pool.size()) {
+        return fail(at);
+      }
+      break;
+    case RegisterInstruction::JZ:
+    case RegisterInstruction::JF:
+    case RegisterInstruction::DECJNZ:
+      regs = 1;
+      std::memcpy(&value, operand + reg, sizeof(int));
+      jumps.emplace_back(at, value);
+      break;
+    case RegisterInstruction::JMP:
+      std::memcpy(&value, operand, sizeof(int));
+      jumps.emplace_back(at, value);
+      break;
+    case RegisterInstruction::END:
+    case RegisterInstruction::DEOPT:
+    case RegisterInstruction::HALT:
+      break;
+    case RegisterInstruction::MOV:
+    case RegisterInstruction::NOT:
+    case RegisterInstruction::INC:
+    case RegisterInstruction::DEC:
+      regs = 2;
+      break;
+    default: // the binary operators
+      regs = 3;
+      break;
+    }
+    for (int i = 0; i < regs; i++) {
+      if (!isRegister(operand + i * reg)) {
+        return fail(at);
+      }
+    }
+    boundary[at] = true;
+    last = instruction;
+    at += size;
+  }
+  if (last != RegisterInstruction::JMP && last != RegisterInstruction::END &&
+      last != RegisterInstruction::DEOPT && last != RegisterInstruction::HALT) {
+    return fail(code.size());
+  }
+  for (auto [at, target] : jumps) {
+    if (target < 0 || target >= code.size() || !boundary[target]) {
+      return fail(at);
+    }
+  }
+
+  for (auto &[at, deopt] : registers.deopts) {
+    if (at < 0 || at >= code.size() || !boundary[at] ||
+        deopt.offset < (int)sizeof(BytecodeHeader) ||
+        deopt.offset > header.poolOffset || _index[deopt.offset] < 0) {
+      return fail(at);
+    }
+    for (auto reg : deopt.stack) {
+      if (reg >= registers.registers) {
+        return fail(at);
+      }
+    }
+  }
+  return true;
+}
+
+void ripl::Engine::setStreams(std::istream &in, std::ostream &out,
+                              std::ostream &err) {
+  _input.setStream(in);
+  _out = &out;
+  _err = &err;
+}
+
+// Clearing keeps the capacity of the stacks around for the next run, and the
+// arena takes back the blocks the strings of this one were allocated from.
+void ripl::Engine::reset() {
+  _ds.clear();
+  _rsDepth = 0;
+  std::fill(_variables.begin(), _variables.end(), Value());
+  _arena.reset();
+}
+
+template <typename T> T ripl::Engine::read() {
+  T value;
+  int len = sizeof(T);
+  std::memcpy((char *)&value, _ip, len);
+  _ip += len;
+  return value;
+}
+
+template <typename T> void ripl::Engine::push(T value) {
+  _ds.emplace_back(value);
+}
+
+template <> void ripl::Engine::push<std::string>(std::string value) {
+  _ds.push_back(string(value));
+}
+
+// A string too long to be held inline is copied to the arena, where it lives
+// until the next run.
+ripl::Value ripl::Engine::string(std::string_view chars) {
+  if (chars.size() <= Value::SMALL) {
+    return Value(chars);
+  }
+  char *copy = _arena.allocate(chars.size());
+  std::memcpy(copy, chars.data(), chars.size());
+  return Value(std::string_view(copy, chars.size()));
+}
+
+ripl::Engine::~Engine() {}
+
+// Reads a line for EXPECT, it becomes a long, double or bool if it looks like
+// one and a string otherwise: digits make a long (or a double should they
+// not fit in one), digits with a point in them a double and true or false in
+// any case a bool. The end of input reads as an empty string. Whatever was
+// printed so far is written out first, it may well be the prompt.
+ripl::Value ripl::Engine::input() {
+  flush();
+  std::string_view line;
+  _input.next(line);
+  const char *first = line.data(), *last = first + line.size();
+  bool number = !line.empty();
+  int points = 0;
+  for (char c : line) {
+    if (c == '.') {
+      points++;
+    } else if (c < '0' || c > '9') {
+      number = false;
+      break;
+    }
+  }
+  if (number && points == 0) {
+    long l;
+    auto [end, error] = std::from_chars(first, last, l);
+    if (error == std::errc() && end == last) {
+      return Value(l);
+    }
+  }
+  if (number && points <= 1) {
+    double d;
+    auto [end, error] = std::from_chars(first, last, d);
+    if (error == std::errc() && end == last) {
+      return Value(d);
+    }
+  }
+  auto is = [line](std::string_view word) {
+    return std::ranges::equal(line, word, [](char c, char lower) {
+      return std::tolower((unsigned char)c) == lower;
+    });
+  };
+  if (is("true") || is("false")) {
+    return Value(is("true"));
+  }
+  return string(line);
+}
+
+// Numbers come out the way an ostream writes them by default, doubles with
+// six significant digits.
+void ripl::Engine::print(const Value &value) {
+  char number[NUMBER_SIZE];
+  switch (value.type) {
+  case ValueType::DOUBLE:
+    write(std::string_view(
+        number, std::to_chars(number, number + NUMBER_SIZE, value.d,
+                              std::chars_format::general, 6)
+                    .ptr));
+    break;
+  case ValueType::LONG:
+    write(std::string_view(
+        number, std::to_chars(number, number + NUMBER_SIZE, value.l).ptr));
+    break;
+  case ValueType::STRING:
+    write(value.str());
+    break;
+  case ValueType::BOOL:
+    write(value.b ? "true" : "false");
+    break;
+  }
+  write("\n");
+}
+
+void ripl::Engine::end(std::size_t stackSize) {
+  write("Stack Size: ");
+  print(Value((long)stackSize));
+}
+
+// PRINT only adds to the buffer, it is written out once full, at the end of
+// the run, before EXPECT reads a line and before an error message.
+void ripl::Engine::write(std::string_view text) {
+  _output.append(text);
+  if (_output.size() >= OUTPUT_SIZE) {
+    _out->write(_output.data(), _output.size());
+    _output.clear();
+  }
+}
+
+void ripl::Engine::flush() {
+  _out->write(_output.data(), _output.size());
+  _output.clear();
+  _out->flush();
+}
+
+std::ostream &ripl::Engine::error() {
+  flush();
+  return *_err;
+}
+
+template <typename Op> bool ripl::Engine::tryOperate(Op operate) {
+  Value &lhs = _ds[_ds.size() - 2];
+  Value result;
+  if (!ripl::arithmetic(lhs, _ds.back(), operate, result)) {
+    return false;
+  }
+  _ds.pop_back();
+  _ds.back() = result;
+  return true;
+}
+
+template <typename Op> void ripl::Engine::compare(Op op) {
+  Value rhs = pop();
+  Value lhs = pop();
+  push(ripl::compare(lhs, rhs, op));
+}
+
+// The run loop is written once against the macros below, pc being the
+// decoded instruction to run next. With RIPL_THREADED_DISPATCH (GCC/Clang
+// labels as values) every handler jumps straight to the next one through the
+// handler stored with it, otherwise it falls back to a portable switch inside
+// a loop.
+//
+// PROFILE runs right before every dispatch and compiles away entirely unless
+// the loop is instantiated with Profile set.
+#define PROFILE()                                                              \
+  if constexpr (Profile) {                                                     \
+    _profiler->step(pc->offset, (unsigned char)pc->instruction);               \
+  }
+#ifdef RIPL_THREADED_DISPATCH
+#define TARGET(op) L_##op:
+#define DEFAULT() L_INVALID:
+#define NEXT()                                                                 \
+  {                                                                            \
+    PROFILE();                                                                 \
+    goto *pc->handler;                                                         \
+  }
+#define SWITCH() NEXT();
+#define LABEL(op) dispatch[(unsigned char)Instruction::op] = &&L_##op
+#else
+#define TARGET(op) case Instruction::op:
+#define DEFAULT() default:
+#define NEXT() continue
+#define SWITCH()                                                               \
+  PROFILE();                                                                   \
+  switch (pc->instruction)
+#endif
+
+void ripl::Engine::profile(bool listing) {
+  _profiler = std::make_unique<Profiler>(_codeLen);
+  _listing = listing;
+}
+
+bool ripl::Engine::jit() {
+  if (_code == nullptr) {
+    return false;
+  }
+  _jit = std::make_unique<Jit>(*this);
+  if (!_jit->isCompiled()) {
+    _jit.reset();
+    return false;
+  }
+  return true;
+}
+
+void ripl::Engine::run() {
+  reset();
+  if (_code == nullptr) {
+    return;
+  }
+  _ip = _code + sizeof(BytecodeHeader);
+  if (!_profiler) {
+    start();
+    flush();
+    return;
+  }
+  execute<true>();
+  flush();
+  _profiler->finish();
+  _profiler->report(*_err, _listing);
+}
+
+// Compiled code, if there is any, runs first. Should it come across
+// something it can't do the interpreter carries on from there.
+void ripl::Engine::start() {
+  if (_jit) {
+    switch (_jit->run()) {
+    case Jit::Exit::HALT:
+      return;
+    case Jit::Exit::END:
+      end(_ds.size());
+      return;
+    // the stack code carries on where the JIT left off, with the stacks it
+    // handed back. The register code could only start over.
+    case Jit::Exit::BAIL:
+      execute<false>();
+      return;
+    }
+  }
+  if (!_registerCode.code.empty() && !_stackOnly) {
+    executeRegisters();
+    return;
+  }
+  execute<false>();
+}
+
+template <bool Profile> void ripl::Engine::execute() {
+#ifdef RIPL_THREADED_DISPATCH
+  void *dispatch[256];
+  for (auto &label : dispatch) {
+    label = &&L_INVALID;
+  }
+  LABEL(NOP);
+  LABEL(PUSHL);
+  LABEL(PUSHD);
+  LABEL(PUSHB);
+  LABEL(PUSHS);
+  LABEL(ADD);
+  LABEL(SUB);
+  LABEL(MUL);
+  LABEL(DIV);
+  LABEL(MOD);
+  LABEL(AND);
+  LABEL(OR);
+  LABEL(NOT);
+  LABEL(EQ);
+  LABEL(NEQ);
+  LABEL(GT);
+  LABEL(LT);
+  LABEL(GTE);
+  LABEL(LTE);
+  LABEL(JZ);
+  LABEL(JF);
+  LABEL(JMP);
+  LABEL(ID);
+  LABEL(CALL);
+  LABEL(RET);
+  LABEL(DUP);
+  LABEL(SWAP);
+  LABEL(ROTUP);
+  LABEL(ROTDN);
+  LABEL(DROP);
+  LABEL(INC);
+  LABEL(DEC);
+  LABEL(EXPECT);
+  LABEL(PRINT);
+  LABEL(ADDLL);
+  LABEL(ADDDD);
+  LABEL(SUBLL);
+  LABEL(SUBDD);
+  LABEL(MULLL);
+  LABEL(MULDD);
+  LABEL(DIVLL);
+  LABEL(DIVDD);
+  LABEL(CONCAT);
+  LABEL(EQLL);
+  LABEL(NEQLL);
+  LABEL(GTLL);
+  LABEL(LTLL);
+  LABEL(GTELL);
+  LABEL(LTELL);
+  LABEL(LOADSLOT);
+  LABEL(STORESLOT);
+  LABEL(DUPJZ);
+  LABEL(DECJNZ);
+  LABEL(ADDL);
+  LABEL(ADDSLOTLL);
+  LABEL(TAILCALL);
+  LABEL(END);
+  LABEL(HALT);
+  // the handlers are labels of this instantiation of the loop.
+  if (_handlers != &&L_NOP) {
+    for (auto &instruction : _decoded) {
+      instruction.handler = dispatch[(unsigned char)instruction.instruction];
+    }
+    _handlers = &&L_NOP;
+  }
+#endif
+  const Decoded *pc = decoded(_ip - _code);
+
+  for (;;) {
+    SWITCH() {
+    TARGET(NOP) {
+      pc++;
+    }
+    NEXT();
+    TARGET(PUSHL) {
+      push(pc->l);
+      pc++;
+    }
+    NEXT();
+    TARGET(PUSHD) {
+      push(pc->d);
+      pc++;
+    }
+    NEXT();
+    TARGET(PUSHB) {
+      push(pc->b);
+      pc++;
+    }
+    NEXT();
+    TARGET(PUSHS) {
+      _ds.push_back(*pc->constant);
+      pc++;
+    }
+    NEXT();
+    TARGET(ADD) {
+      pc++;
+      if (tryOperate(std::plus<>())) {
+        NEXT();
+      }
+      Value &lhs = _ds[_ds.size() - 2];
+      if (ripl::concatenate(lhs, _ds.back(), _arena, lhs)) {
+        _ds.pop_back();
+        NEXT();
+      }
+      error() << "Invalid operands for ADD." << std::endl;
+    }
+    NEXT();
+    TARGET(SUB) {
+      pc++;
+      if (!tryOperate(std::minus<>())) {
+        error() << "Invalid operands for SUB." << std::endl;
+      }
+    }
+    NEXT();
+    TARGET(MUL) {
+      pc++;
+      if (!tryOperate(std::multiplies<>())) {
+        error() << "Invalid operands for MUL." << std::endl;
+      }
+    }
+    NEXT();
+    TARGET(DIV) {
+      pc++;
+      // division always yields a double, even for two longs.
+      if (!tryOperate([](auto lhs, auto rhs) { return (double)lhs / rhs; })) {
+        error() << "Invalid operands for DIV." << std::endl;
+      }
+    }
+    NEXT();
+    TARGET(MOD) {
+      pc++;
+      auto [rvalid, rvalue] = fetch<long>();
+      if (!rvalid) {
+        error() << "Expected a long on the right hand side." << std::endl;
+        NEXT();
+      }
+      auto [lvalid, lvalue] = fetch<long>();
+      if (!lvalid) {
+        error() << "Expected a long on the left hand side." << std::endl;
+        NEXT();
+      }
+      push(lvalue % rvalue);
+    }
+    NEXT();
+    TARGET(AND) {
+      pc++;
+      auto [rvalid, rvalue] = fetch<bool>();
+      if (!rvalid) {
+        error() << "Expected a boolean on right hand side." << std::endl;
+        NEXT();
+      }
+      auto [lvalid, lvalue] = fetch<bool>();
+      if (!lvalid) {
+        error() << "Expected a boolean on left hand side." << std::endl;
+        NEXT();
+      }
+      push(lvalue && rvalue);
+    }
+    NEXT();
+    TARGET(OR) {
+      pc++;
+      auto [rvalid, rvalue] = fetch<bool>();
+      if (!rvalid) {
+        error() << "Expected a boolean on right hand side." << std::endl;
+        NEXT();
+      }
+      auto [lvalid, lvalue] = fetch<bool>();
+      if (!lvalid) {
+        error() << "Expected a boolean on left hand side." << std::endl;
+        NEXT();
+      }
+      push(lvalue || rvalue);
+    }
+    NEXT();
+    TARGET(NOT) {
+      pc++;
+      auto [valid, value] = fetch<bool>();
+      if (!valid) {
+        error() << "Expected a bool on stack." << std::endl;
+        NEXT();
+      }
+      push(!value);
+    }
+    NEXT();
+    TARGET(EQ) {
+      pc++;
+      compare(std::equal_to<>());
+    }
+    NEXT();
+    TARGET(NEQ) {
+      pc++;
+      compare(std::not_equal_to<>());
+    }
+    NEXT();
+    TARGET(GT) {
+      pc++;
+      compare(std::greater<>());
+    }
+    NEXT();
+    TARGET(LT) {
+      pc++;
+      compare(std::less<>());
+    }
+    NEXT();
+    TARGET(GTE) {
+      pc++;
+      compare(std::greater_equal<>());
+    }
+    NEXT();
+    TARGET(LTE) {
+      pc++;
+      compare(std::less_equal<>());
+    }
+    NEXT();
+    TARGET(JZ) {
+      auto [valid, value] = fetch<long>();
+      pc = valid && (value == 0) ? pc->target : pc + 1;
+    }
+    NEXT();
+    TARGET(JF) {
+      auto [valid, value] = fetch<bool>();
+      pc = valid && !value ? pc->target : pc + 1;
+    }
+    NEXT();
+    TARGET(JMP) {
+      pc = pc->target;
+    }
+    NEXT();
+    TARGET(ID) {
+      pc++;
+    }
+    NEXT();
+    TARGET(CALL) {
+      if (_rsDepth == RS_SIZE) {
+        error() << "Return stack overflow at offset " << pc->offset << "."
+                << std::endl;
+        return;
+      }
+      if constexpr (Profile) {
+        _profiler->enter(pc->target->offset);
+      }
+      _rs[_rsDepth++] = pc + 1;
+      pc = pc->target;
+    }
+    NEXT();
+    TARGET(TAILCALL) {
+      if constexpr (Profile) {
+        _profiler->leave();
+        _profiler->enter(pc->target->offset);
+      }
+      pc = pc->target;
+    }
+    NEXT();
+    TARGET(RET) {
+      // nowhere to return to, the program is done.
+      if (_rsDepth == 0) {
+        return;
+      }
+      if constexpr (Profile) {
+        _profiler->leave();
+      }
+      pc = _rs[--_rsDepth];
+    }
+    NEXT();
+    TARGET(DUP) {
+      Value value = _ds.back();
+      push(value);
+      pc++;
+    }
+    NEXT();
+    TARGET(SWAP) {
+      std::swap(_ds[_ds.size() - 1], _ds[_ds.size() - 2]);
+      pc++;
+    }
+    NEXT();
+    TARGET(ROTUP) {
+      // a b c -> c a b, c being the top
+      Value *top = &_ds.back();
+      Value first = top[0];
+      top[0] = top[-1];
+      top[-1] = top[-2];
+      top[-2] = first;
+      pc++;
+    }
+    NEXT();
+    TARGET(ROTDN) {
+      // a b c -> b c a, c being the top
+      Value *top = &_ds.back();
+      Value third = top[-2];
+      top[-2] = top[-1];
+      top[-1] = top[0];
+      top[0] = third;
+      pc++;
+    }
+    NEXT();
+    TARGET(DROP) {
+      _ds.pop_back();
+      pc++;
+    }
+    NEXT();
+    TARGET(INC) {
+      Value &value = _ds.back();
+      if (value.type == ValueType::LONG) {
+        value.l++;
+      }
+      pc++;
+    }
+    NEXT();
+    TARGET(DEC) {
+      Value &value = _ds.back();
+      if (value.type == ValueType::LONG) {
+        value.l--;
+      }
+      pc++;
+    }
+    NEXT();
+    TARGET(EXPECT) {
+      push(input());
+      pc++;
+    }
+    NEXT();
+    TARGET(PRINT) {
+      print(pop());
+      pc++;
+    }
+    NEXT();
+    // The specialized instructions trust the compiler about the operand
+    // types and work on the values directly.
+    TARGET(ADDLL) {
+      Value rhs = pop();
+      _ds.back().l += rhs.l;
+      pc++;
+    }
+    NEXT();
+    TARGET(ADDDD) {
+      Value rhs = pop();
+      _ds.back().d += rhs.d;
+      pc++;
+    }
+    NEXT();
+    TARGET(SUBLL) {
+      Value rhs = pop();
+      _ds.back().l -= rhs.l;
+      pc++;
+    }
+    NEXT();
+    TARGET(SUBDD) {
+      Value rhs = pop();
+      _ds.back().d -= rhs.d;
+      pc++;
+    }
+    NEXT();
+    TARGET(MULLL) {
+      Value rhs = pop();
+      _ds.back().l *= rhs.l;
+      pc++;
+    }
+    NEXT();
+    TARGET(MULDD) {
+      Value rhs = pop();
+      _ds.back().d *= rhs.d;
+      pc++;
+    }
+    NEXT();
+    TARGET(DIVLL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value((double)lhs.l / rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(DIVDD) {
+      Value rhs = pop();
+      _ds.back().d /= rhs.d;
+      pc++;
+    }
+    NEXT();
+    TARGET(CONCAT) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      ripl::concatenate(lhs, rhs, _arena, lhs);
+      pc++;
+    }
+    NEXT();
+    TARGET(EQLL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value(lhs.l == rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(NEQLL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value(lhs.l != rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(GTLL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value(lhs.l > rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(LTLL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value(lhs.l < rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(GTELL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value(lhs.l >= rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(LTELL) {
+      Value rhs = pop();
+      Value &lhs = _ds.back();
+      lhs = Value(lhs.l <= rhs.l);
+      pc++;
+    }
+    NEXT();
+    TARGET(LOADSLOT) {
+      push(*pc->variable);
+      pc++;
+    }
+    NEXT();
+    TARGET(STORESLOT) {
+      *pc->variable = pop();
+      pc++;
+    }
+    NEXT();
+    // DUP JZ, only a counter that isn't a long is actually duplicated.
+    TARGET(DUPJZ) {
+      Value value = _ds.back();
+      if (value.type != ValueType::LONG) {
+        push(value);
+      } else if (value.l == 0) {
+        pc = pc->target;
+        NEXT();
+      }
+      pc++;
+    }
+    NEXT();
+    // DEC followed by the DUPJZ at the head of the loop, offset is the
+    // instruction right after that DUPJZ.
+    TARGET(DECJNZ) {
+      Value &value = _ds.back();
+      if (value.type != ValueType::LONG) {
+        Value copy = value;
+        push(copy);
+        pc = pc->target;
+      } else if (--value.l != 0) {
+        pc = pc->target;
+      } else {
+        pc++;
+      }
+    }
+    NEXT();
+    TARGET(ADDL) {
+      _ds.back().l += pc->l;
+      pc++;
+    }
+    NEXT();
+    TARGET(ADDSLOTLL) {
+      _ds.back().l += pc->variable->l;
+      pc++;
+    }
+    NEXT();
+    TARGET(END) {
+      end(_ds.size());
+      return;
+    }
+    TARGET(HALT) { return; }
+    DEFAULT() {
+      error() << "Invalid instruction " << (int)(unsigned char)pc->instruction
+              << " at offset " << pc->offset << "." << std::endl;
+      return;
+    }
+    }
+  }
+}
+
+// Hands over to the stack code, which carries on with the instruction the
+// register code stopped at.
+bool ripl::Engine::deopt(const char *pc) {
+  int at = pc - _registerCode.code.data();
+  auto itr = _registerCode.deopts.find(at);
+  if (itr == _registerCode.deopts.end()) {
+    error() << "No way back to the stack code at " << at << "." << std::endl;
+    return false;
+  }
+  std::copy_n(_registers.begin(), _variables.size(), _variables.begin());
+  for (auto reg : itr->second.stack) {
+    _ds.push_back(_registers[reg]);
+  }
+  _ip = _code + itr->second.offset;
+  return true;
+}
+
+// The register code is run straight out of its bytes, with _ip pointing
+// into them.
+#undef NEXT
+#undef SWITCH
+#ifdef RIPL_THREADED_DISPATCH
+#define NEXT() goto *dispatch[(unsigned char)*_ip]
+#define SWITCH() NEXT();
+#else
+#define NEXT() continue
+#define SWITCH() switch ((Instruction)*_ip)
+#endif
+#define LEAVE(at)                                                              \
+  {                                                                            \
+    if (deopt(at)) {                                                           \
+      execute<false>();                                                        \
+    }                                                                          \
+    return;                                                                    \
+  }
+
+void ripl::Engine::executeRegisters() {
+  using Instruction = RegisterInstruction; // for the macros
+  const char *code = _registerCode.code.data();
+  std::fill(_registers.begin(), _registers.end(), Value());
+  Value *r = _registers.data();
+  auto reg = [this]() { return read<unsigned short>(); };
+  _ip = code;
+
+#ifdef RIPL_THREADED_DISPATCH
+  void *dispatch[256];
+  for (auto &label : dispatch) {
+    label = &&L_INVALID;
+  }
+  LABEL(MOV);
+  LABEL(LOADL);
+  LABEL(LOADD);
+  LABEL(LOADB);
+  LABEL(LOADS);
+  LABEL(ADD);
+  LABEL(SUB);
+  LABEL(MUL);
+  LABEL(DIV);
+  LABEL(MOD);
+  LABEL(AND);
+  LABEL(OR);
+  LABEL(NOT);
+  LABEL(EQ);
+  LABEL(NEQ);
+  LABEL(GT);
+  LABEL(LT);
+  LABEL(GTE);
+  LABEL(LTE);
+  LABEL(ADDLL);
+  LABEL(ADDDD);
+  LABEL(SUBLL);
+  LABEL(SUBDD);
+  LABEL(MULLL);
+  LABEL(MULDD);
+  LABEL(DIVLL);
+  LABEL(DIVDD);
+  LABEL(CONCAT);
+  LABEL(EQLL);
+  LABEL(NEQLL);
+  LABEL(GTLL);
+  LABEL(LTLL);
+  LABEL(GTELL);
+  LABEL(LTELL);
+  LABEL(INC);
+  LABEL(DEC);
+  LABEL(JMP);
+  LABEL(JZ);
+  LABEL(JF);
+  LABEL(DECJNZ);
+  LABEL(EXPECT);
+  LABEL(PRINT);
+  LABEL(DEOPT);
+  LABEL(END);
+  LABEL(HALT);
+#endif
+
+  for (;;) {
+    SWITCH() {
+    TARGET(MOV) {
+      _ip++;
+      auto a = reg(), b = reg();
+      r[a] = r[b];
+    }
+    NEXT();
+    TARGET(LOADL) {
+      _ip++;
+      auto a = reg();
+      r[a] = Value(read<long>());
+    }
+    NEXT();
+    TARGET(LOADD) {
+      _ip++;
+      auto a = reg();
+      r[a] = Value(read<double>());
+    }
+    NEXT();
+    TARGET(LOADB) {
+      _ip++;
+      auto a = reg();
+      r[a] = Value(read<bool>());
+    }
+    NEXT();
+    TARGET(LOADS) {
+      _ip++;
+      auto a = reg();
+      r[a] = _pool[read<int>()];
+    }
+    NEXT();
+    TARGET(ADD) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      Value result;
+      if (ripl::arithmetic(r[b], r[c], std::plus<>(), result)) {
+        r[a] = result;
+        NEXT();
+      }
+      if (ripl::concatenate(r[b], r[c], _arena, r[a])) {
+        NEXT();
+      }
+      LEAVE(start);
+    }
+    TARGET(SUB) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      Value result;
+      if (!ripl::arithmetic(r[b], r[c], std::minus<>(), result)) {
+        LEAVE(start);
+      }
+      r[a] = result;
+    }
+    NEXT();
+    TARGET(MUL) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      Value result;
+      if (!ripl::arithmetic(r[b], r[c], std::multiplies<>(), result)) {
+        LEAVE(start);
+      }
+      r[a] = result;
+    }
+    NEXT();
+    TARGET(DIV) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      Value result;
+      if (!ripl::arithmetic(r[b], r[c], [](auto lhs, auto rhs) { return (double)lhs / rhs; }, result)) {
+        LEAVE(start);
+      }
+      r[a] = result;
+    }
+    NEXT();
+    TARGET(MOD) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      if (r[b].type != ValueType::LONG || r[c].type != ValueType::LONG) {
+        LEAVE(start);
+      }
+      r[a] = Value(r[b].l % r[c].l);
+    }
+    NEXT();
+    TARGET(AND) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      if (r[b].type != ValueType::BOOL || r[c].type != ValueType::BOOL) {
+        LEAVE(start);
+      }
+      r[a] = Value(r[b].b && r[c].b);
+    }
+    NEXT();
+    TARGET(OR) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      if (r[b].type != ValueType::BOOL || r[c].type != ValueType::BOOL) {
+        LEAVE(start);
+      }
+      r[a] = Value(r[b].b || r[c].b);
+    }
+    NEXT();
+    TARGET(NOT) {
+      const char *start = _ip++;
+      auto a = reg(), b = reg();
+      if (r[b].type != ValueType::BOOL) {
+        LEAVE(start);
+      }
+      r[a] = Value(!r[b].b);
+    }
+    NEXT();
+    TARGET(EQ) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(ripl::compare(r[b], r[c], std::equal_to<>()));
+    }
+    NEXT();
+    TARGET(NEQ) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(ripl::compare(r[b], r[c], std::not_equal_to<>()));
+    }
+    NEXT();
+    TARGET(GT) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(ripl::compare(r[b], r[c], std::greater<>()));
+    }
+    NEXT();
+    TARGET(LT) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(ripl::compare(r[b], r[c], std::less<>()));
+    }
+    NEXT();
+    TARGET(GTE) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(ripl::compare(r[b], r[c], std::greater_equal<>()));
+    }
+    NEXT();
+    TARGET(LTE) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(ripl::compare(r[b], r[c], std::less_equal<>()));
+    }
+    NEXT();
+    TARGET(ADDLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l + r[c].l);
+    }
+    NEXT();
+    TARGET(ADDDD) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].d + r[c].d);
+    }
+    NEXT();
+    TARGET(SUBLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l - r[c].l);
+    }
+    NEXT();
+    TARGET(SUBDD) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].d - r[c].d);
+    }
+    NEXT();
+    TARGET(MULLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l * r[c].l);
+    }
+    NEXT();
+    TARGET(MULDD) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].d * r[c].d);
+    }
+    NEXT();
+    TARGET(DIVLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value((double)r[b].l / r[c].l);
+    }
+    NEXT();
+    TARGET(DIVDD) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].d / r[c].d);
+    }
+    NEXT();
+    TARGET(CONCAT) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      ripl::concatenate(r[b], r[c], _arena, r[a]);
+    }
+    NEXT();
+    TARGET(EQLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l == r[c].l);
+    }
+    NEXT();
+    TARGET(NEQLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l != r[c].l);
+    }
+    NEXT();
+    TARGET(GTLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l > r[c].l);
+    }
+    NEXT();
+    TARGET(LTLL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l < r[c].l);
+    }
+    NEXT();
+    TARGET(GTELL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l >= r[c].l);
+    }
+    NEXT();
+    TARGET(LTELL) {
+      _ip++;
+      auto a = reg(), b = reg(), c = reg();
+      r[a] = Value(r[b].l <= r[c].l);
+    }
+    NEXT();
+    TARGET(INC) {
+      _ip++;
+      auto a = reg(), b = reg();
+      Value value = r[b];
+      if (value.type == ValueType::LONG) {
+        value.l++;
+      }
+      r[a] = value;
+    }
+    NEXT();
+    TARGET(DEC) {
+      _ip++;
+      auto a = reg(), b = reg();
+      Value value = r[b];
+      if (value.type == ValueType::LONG) {
+        value.l--;
+      }
+      r[a] = value;
+    }
+    NEXT();
+    TARGET(JMP) {
+      _ip++;
+      _ip = code + read<int>();
+    }
+    NEXT();
+    TARGET(JZ) {
+      const char *start = _ip++;
+      auto a = reg();
+      int offset = read<int>();
+      if (r[a].type != ValueType::LONG) {
+        LEAVE(start);
+      }
+      if (r[a].l == 0) {
+        _ip = code + offset;
+      }
+    }
+    NEXT();
+    TARGET(JF) {
+      const char *start = _ip++;
+      auto a = reg();
+      int offset = read<int>();
+      if (r[a].type != ValueType::BOOL) {
+        LEAVE(start);
+      }
+      if (!r[a].b) {
+        _ip = code + offset;
+      }
+    }
+    NEXT();
+    TARGET(DECJNZ) {
+      const char *start = _ip++;
+      auto a = reg();
+      int offset = read<int>();
+      if (r[a].type != ValueType::LONG) {
+        LEAVE(start);
+      }
+      if (--r[a].l != 0) {
+        _ip = code + offset;
+      }
+    }
+    NEXT();
+    TARGET(EXPECT) {
+      _ip++;
+      auto a = reg();
+      r[a] = input();
+    }
+    NEXT();
+    TARGET(PRINT) {
+      _ip++;
+      print(r[reg()]);
+    }
+    NEXT();
+    TARGET(DEOPT) { LEAVE(_ip); }
+    TARGET(END) {
+      _ip++;
+      end(read<int>());
+      return;
+    }
+    TARGET(HALT) { return; }
+    DEFAULT() {
+      error() << "Invalid register instruction " << (int)(unsigned char)*_ip
+              << " at " << _ip - code << "." << std::endl;
+      return;
+    }
+    }
+  }
+}
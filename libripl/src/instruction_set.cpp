@@ -0,0 +1,156 @@
+#include "instruction_set.hpp"
+
+const char *ripl::mnemonic(Instruction instruction) {
+  switch (instruction) {
+  case Instruction::NOP:
+    return "NOP";
+  case Instruction::PUSHL:
+    return "PUSHL";
+  case Instruction::PUSHD:
+    return "PUSHD";
+  case Instruction::PUSHB:
+    return "PUSHB";
+  case Instruction::PUSHS:
+    return "PUSHS";
+  case Instruction::ADD:
+    return "ADD";
+  case Instruction::SUB:
+    return "SUB";
+  case Instruction::MUL:
+    return "MUL";
+  case Instruction::DIV:
+    return "DIV";
+  case Instruction::MOD:
+    return "MOD";
+  case Instruction::AND:
+    return "AND";
+  case Instruction::OR:
+    return "OR";
+  case Instruction::NOT:
+    return "NOT";
+  case Instruction::EQ:
+    return "EQ";
+  case Instruction::NEQ:
+    return "NEQ";
+  case Instruction::GT:
+    return "GT";
+  case Instruction::LT:
+    return "LT";
+  case Instruction::GTE:
+    return "GTE";
+  case Instruction::LTE:
+    return "LTE";
+  case Instruction::JZ:
+    return "JZ";
+  case Instruction::JF:
+    return "JF";
+  case Instruction::JMP:
+    return "JMP";
+  case Instruction::ID:
+    return "ID";
+  case Instruction::VAR:
+    return "VAR";
+  case Instruction::ASSIGN:
+    return "ASSIGN";
+  case Instruction::DEREF:
+    return "DEREF";
+  case Instruction::CALL:
+    return "CALL";
+  case Instruction::RET:
+    return "RET";
+  case Instruction::DUP:
+    return "DUP";
+  case Instruction::SWAP:
+    return "SWAP";
+  case Instruction::ROTUP:
+    return "ROTUP";
+  case Instruction::ROTDN:
+    return "ROTDN";
+  case Instruction::DROP:
+    return "DROP";
+  case Instruction::INC:
+    return "INC";
+  case Instruction::DEC:
+    return "DEC";
+  case Instruction::EXPECT:
+    return "EXPECT";
+  case Instruction::PRINT:
+    return "PRINT";
+  case Instruction::ADDLL:
+    return "ADDLL";
+  case Instruction::ADDDD:
+    return "ADDDD";
+  case Instruction::SUBLL:
+    return "SUBLL";
+  case Instruction::SUBDD:
+    return "SUBDD";
+  case Instruction::MULLL:
+    return "MULLL";
+  case Instruction::MULDD:
+    return "MULDD";
+  case Instruction::DIVLL:
+    return "DIVLL";
+  case Instruction::DIVDD:
+    return "DIVDD";
+  case Instruction::CONCAT:
+    return "CONCAT";
+  case Instruction::EQLL:
+    return "EQLL";
+  case Instruction::NEQLL:
+    return "NEQLL";
+  case Instruction::GTLL:
+    return "GTLL";
+  case Instruction::LTLL:
+    return "LTLL";
+  case Instruction::GTELL:
+    return "GTELL";
+  case Instruction::LTELL:
+    return "LTELL";
+  case Instruction::LOADSLOT:
+    return "LOADSLOT";
+  case Instruction::STORESLOT:
+    return "STORESLOT";
+  case Instruction::DUPJZ:
+    return "DUPJZ";
+  case Instruction::DECJNZ:
+    return "DECJNZ";
+  case Instruction::ADDL:
+    return "ADDL";
+  case Instruction::ADDSLOTLL:
+    return "ADDSLOTLL";
+  case Instruction::TAILCALL:
+    return "TAILCALL";
+  case Instruction::HALT:
+    return "HALT";
+  case Instruction::END:
+    return "END";
+  default:
+    return "?";
+  }
+}
+
+int ripl::sizeOf(Instruction instruction) {
+  switch (instruction) {
+  case Instruction::PUSHL:
+  case Instruction::ADDL:
+    return 1 + sizeof(long);
+  case Instruction::PUSHD:
+    return 1 + sizeof(double);
+  case Instruction::PUSHB:
+    return 1 + sizeof(bool);
+  case Instruction::PUSHS:
+  case Instruction::JZ:
+  case Instruction::JF:
+  case Instruction::JMP:
+  case Instruction::DUPJZ:
+  case Instruction::DECJNZ:
+  case Instruction::CALL:
+  case Instruction::TAILCALL:
+  case Instruction::LOADSLOT:
+  case Instruction::STORESLOT:
+  case Instruction::ADDSLOTLL:
+    return 1 + sizeof(int);
+  default:
+    return 1;
+  }
+}
@@ -0,0 +1,666 @@
+#include "jit.hpp"
+#include "bytecode.hpp"
+#include "engine.hpp"
+#include "instruction_set.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef RIPL_HAVE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define JIT_STACK_SIZE 65536  // values on the data stack
+#define JIT_RETURN_SIZE 65536 // nested calls
+#define JIT_GUARD 4           // spare entries below the data stack
+
+// x86 condition codes, CC_ALWAYS is an unconditional jump.
+#define CC_ALWAYS -1
+#define CC_AE 0x3
+#define CC_E 0x4
+#define CC_NE 0x5
+
+// The registers by their number in the encoding.
+enum Register { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R12 = 12, R14 = 14 };
+
+// The displacement of a Context member from rbx.
+#define CTX(member) (unsigned char)offsetof(Jit::Context, member)
+
+static_assert(sizeof(ripl::Value) == 16 && offsetof(ripl::Value, l) == 8,
+              "the templates assume 16 byte values with the payload at 8");
+static_assert(sizeof(ripl::Jit::Context) < 128,
+              "the templates address the context with 8 bit displacements");
+
+// DIV always yields a double, even for two longs.
+struct Divide {
+  template <typename L, typename R> double operator()(L lhs, R rhs) const {
+    return (double)lhs / rhs;
+  }
+};
+
+ripl::Jit::Jit(Engine &engine) : _engine(engine) {
+#ifdef RIPL_HAVE_JIT
+  _stack.resize(JIT_GUARD + JIT_STACK_SIZE);
+  _returns.resize(JIT_RETURN_SIZE);
+  if (compile()) {
+    install();
+  }
+#endif
+}
+
+ripl::Jit::~Jit() {
+#ifdef RIPL_HAVE_JIT
+  if (_memory != nullptr) {
+    munmap(_memory, _size);
+  }
+#endif
+}
+
+ripl::Jit::Exit ripl::Jit::run() {
+  _context.engine = &_engine;
+  _context.sp = _stack.data() + JIT_GUARD;
+  _context.limit = _stack.data() + _stack.size();
+  _context.variables = _engine._variables.data();
+  _context.rs = _context.rsBase = _returns.data();
+  _context.rsLimit = _returns.data() + _returns.size();
+
+  Exit exit = (Exit)_entry(&_context);
+
+  // hand the stacks over to the engine, END reports the size of the data
+  // stack and the interpreter needs both to carry on.
+  _engine._ds.assign(_stack.data() + JIT_GUARD, _context.sp);
+  static_assert(JIT_RETURN_SIZE <= Engine::RS_SIZE);
+  for (int *ret = _context.rsBase; ret < _context.rs; ret++) {
+    _engine._rs[_engine._rsDepth++] = _engine.decoded(*ret);
+  }
+  if (exit == Exit::BAIL) {
+    _engine._ip = _engine._code + _context.bail;
+  }
+  return exit;
+}
+
+// Lays out the exit sequence, the entry sequence and then the code of every
+// instruction in the order of the bytecode, so falling through works the
+// same. The jumps are resolved once every instruction has a label.
+bool ripl::Jit::compile() {
+  BytecodeHeader header;
+  if (!ripl::readHeader(_engine._code, _engine._codeLen, header)) {
+    return false;
+  }
+
+  // exit: restore the native stack, save the stack pointers for run() and
+  // return to the caller of the entry point.
+  _exit = _code.size();
+  bytes({0x48, 0x8b, 0x63, CTX(savedRsp)}); // mov rsp, [rbx+savedRsp]
+  bytes({0x4c, 0x89, 0x63, CTX(sp)});       // mov [rbx+sp], r12
+  bytes({0x4c, 0x89, 0x7b, CTX(rs)});       // mov [rbx+rs], r15
+  bytes({0x48, 0x83, 0xc4, 0x08});          // add rsp, 8
+  bytes({0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c}); // pop r15 .. r12
+  bytes({0x5d, 0x5b, 0xc3});                               // pop rbp, rbx; ret
+
+  // entry: save the callee saved registers, keeping the native stack 16 byte
+  // aligned for the thunks, and load the context into registers.
+  _start = _code.size();
+  bytes({0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});
+  bytes({0x48, 0x83, 0xec, 0x08});          // sub rsp, 8
+  bytes({0x48, 0x89, 0xfb});                // mov rbx, rdi
+  bytes({0x4c, 0x8b, 0x63, CTX(sp)});       // mov r12, [rbx+sp]
+  bytes({0x4c, 0x8b, 0x6b, CTX(limit)});    // mov r13, [rbx+limit]
+  bytes({0x4c, 0x8b, 0x73, CTX(variables)}); // mov r14, [rbx+variables]
+  bytes({0x4c, 0x8b, 0x7b, CTX(rs)});       // mov r15, [rbx+rs]
+  bytes({0x48, 0x89, 0x63, CTX(savedRsp)}); // mov [rbx+savedRsp], rsp
+
+  int offset = sizeof(BytecodeHeader);
+  while (offset < header.poolOffset) {
+    int next = offset + sizeOf((Instruction)_engine._code[offset]);
+    _labels[offset] = _code.size();
+    if (next > header.poolOffset || !translate(offset, next)) {
+      return false;
+    }
+    offset = next;
+  }
+
+  for (auto [position, target] : _jumps) {
+    if (!_labels.contains(target)) {
+      return false;
+    }
+    int rel = _labels[target] - (position + 4);
+    std::memcpy(&_code[position], &rel, sizeof(rel));
+  }
+  for (auto [position, target] : _bails) {
+    bind(position);
+    bytes({0xc7, 0x43, CTX(bail)}); // mov dword [rbx+bail], target
+    operand<int>(target);
+    status(Exit::BAIL);
+  }
+  return true;
+}
+
+bool ripl::Jit::translate(int offset, int next) {
+  const char *code = _engine._code + offset + 1;
+  int length = next - offset - 1;
+  long l = 0;
+  int i = 0;
+  std::memcpy(&l, code, length == sizeof(l) ? sizeof(l) : 0);
+  std::memcpy(&i, code, length == sizeof(i) ? sizeof(i) : 0);
+
+  switch ((Instruction)_engine._code[offset]) {
+  case Instruction::NOP:
+  case Instruction::ID:
+    break;
+  case Instruction::PUSHL:
+    checkOverflow(offset);
+    push(ValueType::LONG, l);
+    break;
+  case Instruction::PUSHD:
+    checkOverflow(offset);
+    push(ValueType::DOUBLE, l);
+    break;
+  case Instruction::PUSHB:
+    checkOverflow(offset);
+    push(ValueType::BOOL, *code != 0);
+    break;
+  case Instruction::PUSHS:
+    if (i < 0 || i >= _engine._pool.size()) {
+      return false;
+    }
+    checkOverflow(offset);
+    push(_engine._pool[i]);
+    break;
+  case Instruction::LOADSLOT:
+    if (i < 0 || i >= _engine._variables.size()) {
+      return false;
+    }
+    checkOverflow(offset);
+    copy(R12, 0, R14, i * sizeof(Value));
+    bytes({0x49, 0x83, 0xc4, 0x10}); // add r12, 16
+    break;
+  case Instruction::STORESLOT:
+    if (i < 0 || i >= _engine._variables.size()) {
+      return false;
+    }
+    bytes({0x49, 0x83, 0xec, 0x10}); // sub r12, 16
+    copy(R14, i * sizeof(Value), R12, 0);
+    break;
+  case Instruction::DUP:
+    checkOverflow(offset);
+    copy(R12, 0, R12, -16);
+    bytes({0x49, 0x83, 0xc4, 0x10}); // add r12, 16
+    break;
+  case Instruction::DROP:
+    bytes({0x49, 0x83, 0xec, 0x10}); // sub r12, 16
+    break;
+  case Instruction::SWAP:
+    // half by half, like copy() does.
+    for (int half = 0; half < sizeof(Value); half += 8) {
+      move(0x8b, RAX, R12, half - 16);
+      move(0x8b, RCX, R12, half - 32);
+      move(0x89, RAX, R12, half - 32);
+      move(0x89, RCX, R12, half - 16);
+    }
+    break;
+  case Instruction::ROTUP:
+  case Instruction::ROTDN: {
+    // a b c -> c a b for ROTUP and b c a for ROTDN, c being the top.
+    bool up = (Instruction)_engine._code[offset] == Instruction::ROTUP;
+    for (int half = 0; half < sizeof(Value); half += 8) {
+      move(0x8b, RAX, R12, half - 48); // a
+      move(0x8b, RCX, R12, half - 32); // b
+      move(0x8b, RDX, R12, half - 16); // c
+      move(0x89, up ? RDX : RCX, R12, half - 48);
+      move(0x89, up ? RAX : RDX, R12, half - 32);
+      move(0x89, up ? RCX : RAX, R12, half - 16);
+    }
+  } break;
+  case Instruction::ADDLL:
+  case Instruction::SUBLL:
+  case Instruction::MULLL:
+  case Instruction::EQLL:
+  case Instruction::NEQLL:
+  case Instruction::GTLL:
+  case Instruction::LTLL:
+  case Instruction::GTELL:
+  case Instruction::LTELL: {
+    Instruction instruction = (Instruction)_engine._code[offset];
+    bytes({0x49, 0x8b, 0x44, 0x24, 0xf8}); // mov rax, [r12-8]
+    bytes({0x49, 0x83, 0xec, 0x10});       // sub r12, 16
+    if (instruction == Instruction::ADDLL) {
+      bytes({0x49, 0x01, 0x44, 0x24, 0xf8}); // add [r12-8], rax
+      break;
+    }
+    if (instruction == Instruction::SUBLL) {
+      bytes({0x49, 0x29, 0x44, 0x24, 0xf8}); // sub [r12-8], rax
+      break;
+    }
+    if (instruction == Instruction::MULLL) {
+      bytes({0x49, 0x0f, 0xaf, 0x44, 0x24, 0xf8}); // imul rax, [r12-8]
+      bytes({0x49, 0x89, 0x44, 0x24, 0xf8});       // mov [r12-8], rax
+      break;
+    }
+    unsigned char set = instruction == Instruction::EQLL    ? 0x94
+                        : instruction == Instruction::NEQLL ? 0x95
+                        : instruction == Instruction::GTLL  ? 0x9f
+                        : instruction == Instruction::LTLL  ? 0x9c
+                        : instruction == Instruction::GTELL ? 0x9d
+                                                            : 0x9e;
+    bytes({0x49, 0x39, 0x44, 0x24, 0xf8}); // cmp [r12-8], rax
+    bytes({0x0f, set, 0xc0});              // setcc al
+    bytes({0x0f, 0xb6, 0xc0});             // movzx eax, al
+    bytes({0x49, 0x89, 0x44, 0x24, 0xf8}); // mov [r12-8], rax
+    type(-16, ValueType::BOOL);
+  } break;
+  case Instruction::ADDDD:
+  case Instruction::SUBDD:
+  case Instruction::MULDD:
+  case Instruction::DIVDD: {
+    Instruction instruction = (Instruction)_engine._code[offset];
+    unsigned char op = instruction == Instruction::ADDDD   ? 0x58
+                       : instruction == Instruction::SUBDD ? 0x5c
+                       : instruction == Instruction::MULDD ? 0x59
+                                                           : 0x5e;
+    bytes({0xf2, 0x41, 0x0f, 0x10, 0x4c, 0x24, 0xf8}); // movsd xmm1, [r12-8]
+    bytes({0x49, 0x83, 0xec, 0x10});                   // sub r12, 16
+    bytes({0xf2, 0x41, 0x0f, 0x10, 0x44, 0x24, 0xf8}); // movsd xmm0, [r12-8]
+    bytes({0xf2, 0x0f, op, 0xc1});                     // op xmm0, xmm1
+    bytes({0xf2, 0x41, 0x0f, 0x11, 0x44, 0x24, 0xf8}); // movsd [r12-8], xmm0
+  } break;
+  case Instruction::DIVLL:
+    bytes({0xf2, 0x49, 0x0f, 0x2a, 0x4c, 0x24, 0xf8}); // cvtsi2sd xmm1, [r12-8]
+    bytes({0x49, 0x83, 0xec, 0x10});                   // sub r12, 16
+    bytes({0xf2, 0x49, 0x0f, 0x2a, 0x44, 0x24, 0xf8}); // cvtsi2sd xmm0, [r12-8]
+    bytes({0xf2, 0x0f, 0x5e, 0xc1});                   // divsd xmm0, xmm1
+    bytes({0xf2, 0x41, 0x0f, 0x11, 0x44, 0x24, 0xf8}); // movsd [r12-8], xmm0
+    type(-16, ValueType::DOUBLE);
+    break;
+  case Instruction::INC:
+  case Instruction::DEC: {
+    bytes({0x41, 0x80, 0x7c, 0x24, 0xf0, (unsigned char)ValueType::LONG});
+    int skip = forward(CC_NE);
+    if ((Instruction)_engine._code[offset] == Instruction::INC) {
+      bytes({0x49, 0xff, 0x44, 0x24, 0xf8}); // inc qword [r12-8]
+    } else {
+      bytes({0x49, 0xff, 0x4c, 0x24, 0xf8}); // dec qword [r12-8]
+    }
+    bind(skip);
+  } break;
+  case Instruction::ADDL:
+    bytes({0x48, 0xb8}); // mov rax, l
+    operand<long>(l);
+    bytes({0x49, 0x01, 0x44, 0x24, 0xf8}); // add [r12-8], rax
+    break;
+  case Instruction::ADDSLOTLL:
+    if (i < 0 || i >= _engine._variables.size()) {
+      return false;
+    }
+    bytes({0x49, 0x8b, 0x86}); // mov rax, [r14+slot+8]
+    operand<int>(i * sizeof(Value) + offsetof(Value, l));
+    bytes({0x49, 0x01, 0x44, 0x24, 0xf8}); // add [r12-8], rax
+    break;
+  case Instruction::JMP:
+    jump(0xe9, i);
+    break;
+  case Instruction::JZ:
+  case Instruction::JF: {
+    // only a value of the type tested is popped.
+    bool jz = (Instruction)_engine._code[offset] == Instruction::JZ;
+    bytes({0x41, 0x80, 0x7c, 0x24, 0xf0,
+           (unsigned char)(jz ? ValueType::LONG : ValueType::BOOL)});
+    int skip = forward(CC_NE);
+    bytes({0x49, 0x83, 0xec, 0x10}); // sub r12, 16
+    if (jz) {
+      bytes({0x49, 0x83, 0x7c, 0x24, 0x08, 0x00}); // cmp qword [r12+8], 0
+    } else {
+      bytes({0x41, 0x80, 0x7c, 0x24, 0x08, 0x00}); // cmp byte [r12+8], 0
+    }
+    jumpIf(CC_E, i);
+    bind(skip);
+  } break;
+  case Instruction::DUPJZ:
+  case Instruction::DECJNZ: {
+    bool dupjz = (Instruction)_engine._code[offset] == Instruction::DUPJZ;
+    bytes({0x41, 0x80, 0x7c, 0x24, 0xf0, (unsigned char)ValueType::LONG});
+    int other = forward(CC_NE);
+    if (dupjz) {
+      bytes({0x49, 0x83, 0x7c, 0x24, 0xf8, 0x00}); // cmp qword [r12-8], 0
+      jumpIf(CC_E, i);
+    } else {
+      bytes({0x49, 0xff, 0x4c, 0x24, 0xf8}); // dec qword [r12-8]
+      jumpIf(CC_NE, i);
+    }
+    int done = forward(CC_ALWAYS);
+    // a counter that isn't a long is duplicated.
+    bind(other);
+    checkOverflow(offset);
+    copy(R12, 0, R12, -16);
+    bytes({0x49, 0x83, 0xc4, 0x10}); // add r12, 16
+    if (!dupjz) {
+      jump(0xe9, i);
+    }
+    bind(done);
+  } break;
+  case Instruction::CALL:
+    // the return offsets are kept as well for the interpreter to take over.
+    bytes({0x4c, 0x3b, 0x7b, CTX(rsLimit)}); // cmp r15, [rbx+rsLimit]
+    bailIf(CC_AE, offset);
+    bytes({0x41, 0xc7, 0x07}); // mov dword [r15], next
+    operand<int>(next);
+    bytes({0x49, 0x83, 0xc7, 0x04}); // add r15, 4
+    bytes({0x48, 0x83, 0xec, 0x08}); // sub rsp, 8
+    jump(0xe8, i);                   // call
+    bytes({0x48, 0x83, 0xc4, 0x08}); // add rsp, 8
+    break;
+  // the subroutine returns straight to the caller of this one.
+  case Instruction::TAILCALL:
+    jump(0xe9, i);
+    break;
+  case Instruction::RET: {
+    // nowhere to return to, the program is done.
+    bytes({0x4c, 0x3b, 0x7b, CTX(rsBase)}); // cmp r15, [rbx+rsBase]
+    int skip = forward(CC_NE);
+    status(Exit::HALT);
+    bind(skip);
+    bytes({0x49, 0x83, 0xef, 0x04}); // sub r15, 4
+    bytes({0xc3});                   // ret
+  } break;
+  case Instruction::ADD:
+    thunk(add);
+    break;
+  case Instruction::SUB:
+    thunk(arithmetic<std::minus<>, Instruction::SUB>);
+    break;
+  case Instruction::MUL:
+    thunk(arithmetic<std::multiplies<>, Instruction::MUL>);
+    break;
+  case Instruction::DIV:
+    thunk(arithmetic<Divide, Instruction::DIV>);
+    break;
+  case Instruction::MOD:
+    thunk(mod);
+    break;
+  case Instruction::AND:
+    thunk(logic<true>);
+    break;
+  case Instruction::OR:
+    thunk(logic<false>);
+    break;
+  case Instruction::NOT:
+    thunk(negate);
+    break;
+  case Instruction::EQ:
+    thunk(compare<std::equal_to<>>);
+    break;
+  case Instruction::NEQ:
+    thunk(compare<std::not_equal_to<>>);
+    break;
+  case Instruction::GT:
+    thunk(compare<std::greater<>>);
+    break;
+  case Instruction::LT:
+    thunk(compare<std::less<>>);
+    break;
+  case Instruction::GTE:
+    thunk(compare<std::greater_equal<>>);
+    break;
+  case Instruction::LTE:
+    thunk(compare<std::less_equal<>>);
+    break;
+  case Instruction::CONCAT:
+    thunk(concat);
+    break;
+  case Instruction::PRINT:
+    thunk(print);
+    break;
+  case Instruction::EXPECT:
+    checkOverflow(offset);
+    thunk(expect);
+    break;
+  case Instruction::END:
+    status(Exit::END);
+    break;
+  case Instruction::HALT:
+    status(Exit::HALT);
+    break;
+  default:
+    bailIf(CC_ALWAYS, offset);
+    break;
+  }
+  return true;
+}
+
+void ripl::Jit::bytes(std::initializer_list<unsigned char> code) {
+  _code.insert(_code.end(), code);
+}
+
+template <typename T> void ripl::Jit::operand(T value) {
+  unsigned char *bytes = (unsigned char *)&value;
+  _code.insert(_code.end(), bytes, bytes + sizeof(T));
+}
+
+// A jump (0xe9) or call (0xe8) to the instruction at offset.
+void ripl::Jit::jump(unsigned char opcode, int offset) {
+  bytes({opcode});
+  _jumps.push_back({(int)_code.size(), offset});
+  operand<int>(0);
+}
+
+void ripl::Jit::jumpIf(int condition, int offset) {
+  bytes({0x0f, (unsigned char)(0x80 + condition)});
+  _jumps.push_back({(int)_code.size(), offset});
+  operand<int>(0);
+}
+
+// Leaves for the interpreter to run the instruction at offset.
+void ripl::Jit::bailIf(int condition, int offset) {
+  _bails.push_back({forward(condition), offset});
+}
+
+// A jump to somewhere further down, returns where to bind it.
+int ripl::Jit::forward(int condition) {
+  if (condition == CC_ALWAYS) {
+    bytes({0xe9});
+  } else {
+    bytes({0x0f, (unsigned char)(0x80 + condition)});
+  }
+  int position = _code.size();
+  operand<int>(0);
+  return position;
+}
+
+void ripl::Jit::bind(int position) {
+  int rel = _code.size() - (position + 4);
+  std::memcpy(&_code[position], &rel, sizeof(rel));
+}
+
+void ripl::Jit::checkOverflow(int offset) {
+  bytes({0x4d, 0x39, 0xec}); // cmp r12, r13
+  bailIf(CC_AE, offset);
+}
+
+// A mov (0x8b loads, 0x89 stores) of a whole register from or to memory at
+// base + displacement.
+void ripl::Jit::move(unsigned char opcode, int reg, int base,
+                     int displacement) {
+  bool small = displacement >= -128 && displacement < 128;
+  bytes({(unsigned char)(0x48 | (reg & 8) >> 1 | (base & 8) >> 3), opcode,
+         (unsigned char)((small ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7))});
+  if ((base & 7) == RSP) {
+    bytes({0x24}); // SIB, no index
+  }
+  if (small) {
+    bytes({(unsigned char)displacement});
+  } else {
+    operand<int>(displacement);
+  }
+}
+
+// Copies a value as two 8 byte halves. A single 16 byte move would read back
+// halves just written on their own (INC, ADDL, ...) in one go, which the
+// processor can't forward from its store buffer.
+void ripl::Jit::copy(int toBase, int to, int fromBase, int from) {
+  move(0x8b, RAX, fromBase, from);
+  move(0x8b, RDX, fromBase, from + 8);
+  move(0x89, RAX, toBase, to);
+  move(0x89, RDX, toBase, to + 8);
+}
+
+// The type is written as a whole 8 bytes for the same reason.
+void ripl::Jit::type(int displacement, ValueType type) {
+  bytes({0x49, 0xc7, 0x44, 0x24, (unsigned char)displacement}); // mov [r12+d]
+  operand<int>((int)type);
+}
+
+void ripl::Jit::push(ValueType type, long bits) {
+  this->type(0, type);
+  bytes({0x48, 0xb8}); // mov rax, bits
+  operand<long>(bits);
+  bytes({0x49, 0x89, 0x44, 0x24, 0x08}); // mov [r12+8], rax
+  bytes({0x49, 0x83, 0xc4, 0x10});       // add r12, 16
+}
+
+// Strings can't leave the first half to the type, it may hold their chars.
+void ripl::Jit::push(const Value &value) {
+  long halves[2];
+  std::memcpy(halves, &value, sizeof(Value));
+  for (int half = 0; half < 2; half++) {
+    bytes({0x48, 0xb8}); // mov rax, half
+    operand<long>(halves[half]);
+    // mov [r12+8*half], rax
+    bytes({0x49, 0x89, 0x44, 0x24, (unsigned char)(half * 8)});
+  }
+  bytes({0x49, 0x83, 0xc4, 0x10}); // add r12, 16
+}
+
+void ripl::Jit::thunk(Value *(*function)(Context *, Value *)) {
+  bytes({0x48, 0x89, 0xdf}); // mov rdi, rbx
+  bytes({0x4c, 0x89, 0xe6}); // mov rsi, r12
+  bytes({0x48, 0xb8});       // mov rax, function
+  operand<long>((long)function);
+  bytes({0xff, 0xd0});       // call rax
+  bytes({0x49, 0x89, 0xc4}); // mov r12, rax
+}
+
+void ripl::Jit::status(Exit exit) {
+  bytes({0xb8}); // mov eax, exit
+  operand<int>((int)exit);
+  bytes({0xe9});
+  operand<int>(_exit - ((int)_code.size() + 4));
+}
+
+// Copies the code into memory of its own which is then made executable.
+bool ripl::Jit::install() {
+#ifdef RIPL_HAVE_JIT
+  long page = sysconf(_SC_PAGESIZE);
+  _size = (_code.size() + page - 1) / page * page;
+  void *memory = mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+  std::memcpy(memory, _code.data(), _code.size());
+  if (mprotect(memory, _size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, _size);
+    return false;
+  }
+  _memory = memory;
+  _entry = (Entry)((char *)_memory + _start);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// The thunks below do what the interpreter does for the same instruction,
+// errors included.
+
+ripl::Value *ripl::Jit::add(Context *context, Value *sp) {
+  Value &lhs = sp[-2];
+  Value result;
+  if (ripl::arithmetic(lhs, sp[-1], std::plus<>(), result)) {
+    lhs = result;
+    return sp - 1;
+  }
+  if (ripl::concatenate(lhs, sp[-1], context->engine->_arena, lhs)) {
+    return sp - 1;
+  }
+  context->engine->error() << "Invalid operands for ADD." << std::endl;
+  return sp;
+}
+
+template <typename Op, ripl::Instruction instruction>
+ripl::Value *ripl::Jit::arithmetic(Context *context, Value *sp) {
+  Value result;
+  if (!ripl::arithmetic(sp[-2], sp[-1], Op(), result)) {
+    context->engine->error() << "Invalid operands for "
+                             << mnemonic(instruction) << "." << std::endl;
+    return sp;
+  }
+  sp[-2] = result;
+  return sp - 1;
+}
+
+template <typename Op>
+ripl::Value *ripl::Jit::compare(Context *, Value *sp) {
+  sp[-2] = Value(ripl::compare(sp[-2], sp[-1], Op()));
+  return sp - 1;
+}
+
+ripl::Value *ripl::Jit::mod(Context *context, Value *sp) {
+  if (sp[-1].type != ValueType::LONG) {
+    context->engine->error() << "Expected a long on the right hand side."
+                             << std::endl;
+    return sp;
+  }
+  Value rhs = *--sp;
+  if (sp[-1].type != ValueType::LONG) {
+    context->engine->error() << "Expected a long on the left hand side."
+                             << std::endl;
+    return sp;
+  }
+  sp[-1] = Value(sp[-1].l % rhs.l);
+  return sp;
+}
+
+template <bool And>
+ripl::Value *ripl::Jit::logic(Context *context, Value *sp) {
+  if (sp[-1].type != ValueType::BOOL) {
+    context->engine->error() << "Expected a boolean on right hand side."
+                             << std::endl;
+    return sp;
+  }
+  Value rhs = *--sp;
+  if (sp[-1].type != ValueType::BOOL) {
+    context->engine->error() << "Expected a boolean on left hand side."
+                             << std::endl;
+    return sp;
+  }
+  sp[-1] = Value(And ? sp[-1].b && rhs.b : sp[-1].b || rhs.b);
+  return sp;
+}
+
+ripl::Value *ripl::Jit::negate(Context *context, Value *sp) {
+  if (sp[-1].type != ValueType::BOOL) {
+    context->engine->error() << "Expected a bool on stack." << std::endl;
+    return sp;
+  }
+  sp[-1] = Value(!sp[-1].b);
+  return sp;
+}
+
+ripl::Value *ripl::Jit::concat(Context *context, Value *sp) {
+  ripl::concatenate(sp[-2], sp[-1], context->engine->_arena, sp[-2]);
+  return sp - 1;
+}
+
+ripl::Value *ripl::Jit::print(Context *context, Value *sp) {
+  context->engine->print(sp[-1]);
+  return sp - 1;
+}
+
+ripl::Value *ripl::Jit::expect(Context *context, Value *sp) {
+  *sp = context->engine->input();
+  return sp + 1;
+}
@@ -0,0 +1,78 @@
+#include "line_reader.hpp"
+#include <cstring>
+#include <iostream>
+#include <istream>
+#include <string_view>
+
+#if __has_include(<unistd.h>)
+#include <cerrno>
+#include <unistd.h>
+#define RIPL_HAVE_READ
+#endif
+
+#define CHUNK_SIZE 65536
+
+void ripl::LineReader::setStream(std::istream &in) {
+  _stream = &in;
+#ifdef RIPL_HAVE_READ
+  _standardInput = &in == &std::cin;
+#endif
+  _end = false;
+  _next = _last = nullptr;
+}
+
+void ripl::LineReader::setText(std::string_view text) {
+  _stream = nullptr;
+  _end = true;
+  _next = text.data();
+  _last = text.data() + text.size();
+}
+
+bool ripl::LineReader::next(std::string_view &line) {
+  for (;;) {
+    auto newline = _next == _last ? nullptr
+                                  : (const char *)std::memchr(
+                                        _next, '\n', _last - _next);
+    if (newline != nullptr) {
+      line = std::string_view(_next, newline - _next);
+      _next = newline + 1;
+      return true;
+    }
+    if (_end) {
+      // the last line needn't end in a newline.
+      line = std::string_view(_next, _last - _next);
+      _next = _last;
+      return !line.empty();
+    }
+    fill();
+  }
+}
+
+// Moves what is left of the current line to the front of the buffer, which
+// grows if the line fills all of it, and reads a chunk after it.
+void ripl::LineReader::fill() {
+  std::size_t left = _last - _next;
+  if (_buffer.size() < left + CHUNK_SIZE) {
+    std::vector<char> buffer(left + CHUNK_SIZE);
+    std::memcpy(buffer.data(), _next, left);
+    _buffer.swap(buffer);
+  } else {
+    std::memmove(_buffer.data(), _next, left);
+  }
+  char *chunk = _buffer.data() + left;
+  std::size_t size = _buffer.size() - left;
+  long read = 0;
+#ifdef RIPL_HAVE_READ
+  if (_standardInput) {
+    do {
+      read = ::read(STDIN_FILENO, chunk, size);
+    } while (read < 0 && errno == EINTR);
+  } else
+#endif
+  {
+    read = _stream->rdbuf()->sgetn(chunk, size);
+  }
+  _end = read <= 0;
+  _next = _buffer.data();
+  _last = chunk + (read > 0 ? read : 0);
+}
@@ -0,0 +1,75 @@
+#include "mapped_file.hpp"
+#include <fstream>
+#include <ios>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RIPL_HAVE_MMAP
+#endif
+
+ripl::MappedFile::MappedFile(const char *filename, bool map) {
+  if (map && _map(filename)) {
+    return;
+  }
+  _read(filename);
+}
+
+ripl::MappedFile::~MappedFile() {
+#ifdef RIPL_HAVE_MMAP
+  if (_mapped) {
+    munmap((void *)_data, _length);
+    return;
+  }
+#endif
+  delete[] _data;
+}
+
+bool ripl::MappedFile::_map(const char *filename) {
+#ifdef RIPL_HAVE_MMAP
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping stays valid after the descriptor is closed
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  // the whole image is going to be used, ask for it to be paged in right away.
+  madvise(addr, st.st_size, MADV_WILLNEED);
+
+  _data = (const char *)addr;
+  _length = st.st_size;
+  _mapped = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ripl::MappedFile::_read(const char *filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  // seek to the end to get the size of the file and then read the whole file in
+  // one shot.
+  in.seekg(0, std::ios::end);
+  _length = in.tellg();
+  in.seekg(0, std::ios::beg);
+
+  char *buffer = new char[_length];
+  in.read(buffer, _length);
+  _data = buffer;
+  return true;
+}
@@ -0,0 +1,163 @@
+#include "profiler.hpp"
+#include "instruction_set.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#define TICK_UNIT "cycles"
+#else
+#define TICK_UNIT "ns"
+#endif
+
+#define HOTTEST 20
+
+ripl::Profiler::Profiler(int codeLength)
+    : _offsets(codeLength), _opcodeAt(codeLength),
+      _subroutines(codeLength), _active(codeLength) {}
+
+std::uint64_t ripl::Profiler::ticks() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void ripl::Profiler::step(int offset, unsigned char opcode) {
+  std::uint64_t now = ticks();
+  charge(now);
+  _opcodes[opcode].count++;
+  _offsets[offset].count++;
+  _opcodeAt[offset] = opcode;
+  _last = offset;
+  _start = now;
+}
+
+void ripl::Profiler::enter(int address) {
+  _subroutines[address].count++;
+  _active[address]++;
+  _frames.push_back({address, ticks()});
+}
+
+// Recursive calls are only charged once, by the outermost activation.
+void ripl::Profiler::leave() {
+  if (_frames.empty()) {
+    return;
+  }
+  Frame frame = _frames.back();
+  _frames.pop_back();
+  if (--_active[frame.address] == 0) {
+    _subroutines[frame.address].ticks += ticks() - frame.start;
+  }
+}
+
+// Charges the instruction that ended the run.
+void ripl::Profiler::finish() {
+  charge(ticks());
+  _last = -1;
+}
+
+void ripl::Profiler::charge(std::uint64_t now) {
+  if (_last == -1) {
+    return;
+  }
+  std::uint64_t elapsed = now - _start;
+  _offsets[_last].ticks += elapsed;
+  _opcodes[_opcodeAt[_last]].ticks += elapsed;
+  _total += elapsed;
+}
+
+static double percent(std::uint64_t part, std::uint64_t whole) {
+  return whole == 0 ? 0 : 100.0 * part / whole;
+}
+
+void ripl::Profiler::report(std::ostream &out, bool listing) {
+  std::uint64_t executed = 0;
+  for (auto &counter : _opcodes) {
+    executed += counter.count;
+  }
+  out << "Profile: " << executed << " instructions, " << _total
+      << " " TICK_UNIT "." << std::endl;
+  out << std::fixed << std::setprecision(1);
+
+  std::vector<int> opcodes;
+  for (int i = 0; i < 256; i++) {
+    if (_opcodes[i].count > 0) {
+      opcodes.push_back(i);
+    }
+  }
+  std::sort(opcodes.begin(), opcodes.end(), [this](int a, int b) {
+    return _opcodes[a].ticks > _opcodes[b].ticks;
+  });
+  out << std::endl << "By instruction:" << std::endl;
+  for (int opcode : opcodes) {
+    Counter &counter = _opcodes[opcode];
+    out << "  " << std::left << std::setw(10) << mnemonic((Instruction)opcode)
+        << std::right << std::setw(12) << counter.count << std::setw(7)
+        << percent(counter.count, executed) << "%" << std::setw(14)
+        << counter.ticks << " " TICK_UNIT << std::setw(7)
+        << percent(counter.ticks, _total) << "%" << std::setw(9)
+        << (double)counter.ticks / counter.count << " per op" << std::endl;
+  }
+
+  std::vector<int> subroutines;
+  for (int i = 0; i < _subroutines.size(); i++) {
+    if (_subroutines[i].count > 0) {
+      subroutines.push_back(i);
+    }
+  }
+  if (!subroutines.empty()) {
+    std::sort(subroutines.begin(), subroutines.end(), [this](int a, int b) {
+      return _subroutines[a].ticks > _subroutines[b].ticks;
+    });
+    out << std::endl << "By subroutine (including callees):" << std::endl;
+    for (int address : subroutines) {
+      Counter &counter = _subroutines[address];
+      out << "  @" << std::left << std::setw(9) << address << std::right
+          << std::setw(12) << counter.count << " calls" << std::setw(14)
+          << counter.ticks << " " TICK_UNIT << std::setw(7)
+          << percent(counter.ticks, _total) << "%" << std::endl;
+    }
+  }
+
+  std::vector<int> offsets;
+  for (int i = 0; i < _offsets.size(); i++) {
+    if (_offsets[i].count > 0) {
+      offsets.push_back(i);
+    }
+  }
+  std::vector<int> hottest = offsets;
+  std::sort(hottest.begin(), hottest.end(), [this](int a, int b) {
+    return _offsets[a].ticks > _offsets[b].ticks;
+  });
+  if (hottest.size() > HOTTEST) {
+    hottest.resize(HOTTEST);
+  }
+  out << std::endl << "Hottest offsets:" << std::endl;
+  for (int offset : hottest) {
+    Counter &counter = _offsets[offset];
+    out << "  " << std::setw(6) << offset << " " << std::left << std::setw(10)
+        << mnemonic((Instruction)_opcodeAt[offset]) << std::right
+        << std::setw(12) << counter.count << std::setw(14) << counter.ticks
+        << " " TICK_UNIT << std::setw(7) << percent(counter.ticks, _total)
+        << "%" << std::endl;
+  }
+
+  if (listing) {
+    out << std::endl << "Listing (executed instructions only):" << std::endl;
+    for (int offset : offsets) {
+      Counter &counter = _offsets[offset];
+      out << "  " << std::setw(6) << offset << " " << std::left
+          << std::setw(10) << mnemonic((Instruction)_opcodeAt[offset])
+          << std::right << std::setw(12) << counter.count << std::setw(14)
+          << counter.ticks << " " TICK_UNIT << std::endl;
+    }
+  }
+  out << std::defaultfloat;
+}
@@ -0,0 +1,131 @@
+#include "register_set.hpp"
+
+const char *ripl::mnemonic(RegisterInstruction instruction) {
+  switch (instruction) {
+  case RegisterInstruction::MOV:
+    return "MOV";
+  case RegisterInstruction::LOADL:
+    return "LOADL";
+  case RegisterInstruction::LOADD:
+    return "LOADD";
+  case RegisterInstruction::LOADB:
+    return "LOADB";
+  case RegisterInstruction::LOADS:
+    return "LOADS";
+  case RegisterInstruction::ADD:
+    return "ADD";
+  case RegisterInstruction::SUB:
+    return "SUB";
+  case RegisterInstruction::MUL:
+    return "MUL";
+  case RegisterInstruction::DIV:
+    return "DIV";
+  case RegisterInstruction::MOD:
+    return "MOD";
+  case RegisterInstruction::AND:
+    return "AND";
+  case RegisterInstruction::OR:
+    return "OR";
+  case RegisterInstruction::NOT:
+    return "NOT";
+  case RegisterInstruction::EQ:
+    return "EQ";
+  case RegisterInstruction::NEQ:
+    return "NEQ";
+  case RegisterInstruction::GT:
+    return "GT";
+  case RegisterInstruction::LT:
+    return "LT";
+  case RegisterInstruction::GTE:
+    return "GTE";
+  case RegisterInstruction::LTE:
+    return "LTE";
+  case RegisterInstruction::ADDLL:
+    return "ADDLL";
+  case RegisterInstruction::ADDDD:
+    return "ADDDD";
+  case RegisterInstruction::SUBLL:
+    return "SUBLL";
+  case RegisterInstruction::SUBDD:
+    return "SUBDD";
+  case RegisterInstruction::MULLL:
+    return "MULLL";
+  case RegisterInstruction::MULDD:
+    return "MULDD";
+  case RegisterInstruction::DIVLL:
+    return "DIVLL";
+  case RegisterInstruction::DIVDD:
+    return "DIVDD";
+  case RegisterInstruction::CONCAT:
+    return "CONCAT";
+  case RegisterInstruction::EQLL:
+    return "EQLL";
+  case RegisterInstruction::NEQLL:
+    return "NEQLL";
+  case RegisterInstruction::GTLL:
+    return "GTLL";
+  case RegisterInstruction::LTLL:
+    return "LTLL";
+  case RegisterInstruction::GTELL:
+    return "GTELL";
+  case RegisterInstruction::LTELL:
+    return "LTELL";
+  case RegisterInstruction::INC:
+    return "INC";
+  case RegisterInstruction::DEC:
+    return "DEC";
+  case RegisterInstruction::JMP:
+    return "JMP";
+  case RegisterInstruction::JZ:
+    return "JZ";
+  case RegisterInstruction::JF:
+    return "JF";
+  case RegisterInstruction::DECJNZ:
+    return "DECJNZ";
+  case RegisterInstruction::EXPECT:
+    return "EXPECT";
+  case RegisterInstruction::PRINT:
+    return "PRINT";
+  case RegisterInstruction::DEOPT:
+    return "DEOPT";
+  case RegisterInstruction::END:
+    return "END";
+  case RegisterInstruction::HALT:
+    return "HALT";
+  default:
+    return "?";
+  }
+}
+
+int ripl::sizeOf(RegisterInstruction instruction) {
+  const int reg = sizeof(unsigned short);
+  switch (instruction) {
+  case RegisterInstruction::MOV:
+  case RegisterInstruction::NOT:
+  case RegisterInstruction::INC:
+  case RegisterInstruction::DEC:
+    return 1 + 2 * reg;
+  case RegisterInstruction::LOADL:
+    return 1 + reg + sizeof(long);
+  case RegisterInstruction::LOADD:
+    return 1 + reg + sizeof(double);
+  case RegisterInstruction::LOADB:
+    return 1 + reg + sizeof(bool);
+  case RegisterInstruction::LOADS:
+  case RegisterInstruction::JZ:
+  case RegisterInstruction::JF:
+  case RegisterInstruction::DECJNZ:
+    return 1 + reg + sizeof(int);
+  case RegisterInstruction::JMP:
+  case RegisterInstruction::END:
+    return 1 + sizeof(int);
+  case RegisterInstruction::EXPECT:
+  case RegisterInstruction::PRINT:
+    return 1 + reg;
+  case RegisterInstruction::DEOPT:
+  case RegisterInstruction::HALT:
+    return 1;
+  default: // the binary operators
+    return 1 + 3 * reg;
+  }
+}
@@ -0,0 +1,53 @@
+#include "value.hpp"
+#include "arena.hpp"
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+// Room for any long and any double in fixed notation, the largest doubles
+// have over 300 digits in front of the point.
+#define NUMBER_SIZE 512
+
+// Numbers are formatted the way std::to_string does it, doubles with six
+// digits after the point.
+static bool textOf(const ripl::Value &value, char *buffer,
+                   std::string_view &text) {
+  std::to_chars_result result;
+  switch (value.type) {
+  case ripl::ValueType::STRING:
+    text = value.str();
+    return true;
+  case ripl::ValueType::LONG:
+    result = std::to_chars(buffer, buffer + NUMBER_SIZE, value.l);
+    break;
+  case ripl::ValueType::DOUBLE:
+    result = std::to_chars(buffer, buffer + NUMBER_SIZE, value.d,
+                           std::chars_format::fixed, 6);
+    break;
+  default:
+    return false;
+  }
+  text = std::string_view(buffer, result.ptr - buffer);
+  return true;
+}
+
+// Both sides are taken apart before result is written, it may well be one
+// of them.
+bool ripl::concatenate(const Value &lhs, const Value &rhs, Arena &arena,
+                       Value &result) {
+  if (lhs.type != ValueType::STRING && rhs.type != ValueType::STRING) {
+    return false;
+  }
+  char lhsBuffer[NUMBER_SIZE], rhsBuffer[NUMBER_SIZE];
+  std::string_view left, right;
+  if (!textOf(lhs, lhsBuffer, left) || !textOf(rhs, rhsBuffer, right)) {
+    return false;
+  }
+  std::size_t length = left.size() + right.size();
+  char small[Value::SMALL];
+  char *chars = length <= Value::SMALL ? small : arena.allocate(length);
+  std::memcpy(chars, left.data(), left.size());
+  std::memcpy(chars + left.size(), right.data(), right.size());
+  result = Value(std::string_view(chars, length));
+  return true;
+}
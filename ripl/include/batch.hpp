@@ -0,0 +1,48 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace ripl {
+// Runs one program over every line of an input file, each line is the input
+// of a run of its own. The runs are spread over worker threads that all
+// execute the same code image, each with an Engine (and so stacks and
+// variables) of its own. Every worker starts out with an equal share of the
+// lines and steals half of what another has left once it runs out. The
+// outputs are written in the order of the input lines. With jit every
+// worker compiles the program to machine code of its own first, with stack
+// they ignore any register code.
+class Batch {
+public:
+  // The image has to outlive the batch.
+  Batch(std::string_view program, MappedFile &inputs, int threads,
+        bool jit = false, bool stack = false);
+
+  void run(std::ostream &out);
+
+private:
+  // The lines [next, end) still to be run by a worker.
+  struct Queue {
+    std::mutex lock;
+    int next = 0;
+    int end = 0;
+  };
+
+  std::string_view _program;
+  bool _jit;
+  bool _stack;
+  std::vector<std::string_view> _records;
+  std::vector<std::string> _outputs;
+  std::vector<std::atomic<bool>> _done;
+  std::vector<std::unique_ptr<Queue>> _queues;
+
+  void work(int worker);
+  bool take(int worker, int &record);
+  bool steal(int worker);
+};
+} // namespace ripl
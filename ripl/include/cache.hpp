@@ -0,0 +1,46 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+namespace ripl {
+// Compiled images of scripts kept on disk, so running a script that hasn't
+// changed skips compiling it. An entry is named after a hash of the source,
+// the bytecode version it was compiled for and the build of ripl that
+// compiled it, and holds the image followed by a Stamp. Entries are written to a file of their own first and renamed
+// into place, so readers (other ripl processes included) never see half of
+// one. Without a usable directory scripts are simply compiled every time.
+class Cache {
+public:
+  Cache(std::filesystem::path directory);
+
+  // RIPL_CACHE_DIR if set, ripl under XDG_CACHE_HOME or ~/.cache otherwise,
+  // empty if there is neither.
+  static std::filesystem::path defaultDirectory();
+
+  // Gets the image of the script, compiling it on a miss. With report the
+  // hit or miss and the time saved are written to cerr.
+  bool open(const char *script, bool report = false);
+  std::string_view image() { return _image; }
+
+private:
+  struct Stamp {
+    char magic[4];      // "RIPC"
+    std::size_t length; // of the image in front of it
+    long compileTime;   // microseconds it took to compile
+  };
+
+  std::filesystem::path _directory;
+  std::unique_ptr<MappedFile> _entry; // on a hit
+  std::string _compiled;              // on a miss
+  std::string_view _image;
+
+  std::filesystem::path entry(std::uint64_t hash, std::size_t length);
+  bool lookup(const std::filesystem::path &path, long &compileTime);
+  void store(const std::filesystem::path &path, long compileTime);
+};
+} // namespace ripl
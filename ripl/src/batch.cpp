@@ -0,0 +1,120 @@
+#include "batch.hpp"
+#include "engine.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+ripl::Batch::Batch(std::string_view program, MappedFile &inputs, int threads,
+                   bool jit, bool stack)
+    : _program(program), _jit(jit), _stack(stack) {
+  std::string_view text(inputs.data(), inputs.length());
+  while (!text.empty()) {
+    auto newline = text.find('\n');
+    if (newline == std::string_view::npos) {
+      newline = text.length();
+    }
+    _records.push_back(text.substr(0, newline));
+    text.remove_prefix(std::min(newline + 1, text.length()));
+  }
+  _outputs.resize(_records.size());
+  _done = std::vector<std::atomic<bool>>(_records.size());
+
+  int share = (_records.size() + threads - 1) / threads;
+  for (int i = 0; i < threads; i++) {
+    auto queue = std::make_unique<Queue>();
+    queue->next = std::min<int>(i * share, _records.size());
+    queue->end = std::min<int>(queue->next + share, _records.size());
+    _queues.push_back(std::move(queue));
+  }
+}
+
+// The calling thread writes out the results as soon as the next one in line
+// is done, releasing it straight away.
+void ripl::Batch::run(std::ostream &out) {
+  std::vector<std::thread> workers;
+  for (int i = 0; i < _queues.size(); i++) {
+    workers.emplace_back(&Batch::work, this, i);
+  }
+  for (int i = 0; i < _records.size(); i++) {
+    _done[i].wait(false, std::memory_order_acquire);
+    out << _outputs[i];
+    std::string().swap(_outputs[i]);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  out.flush();
+}
+
+void ripl::Batch::work(int worker) {
+  Engine engine(_program.data(), _program.size());
+  std::istringstream in;
+  std::ostringstream out;
+  engine.setStreams(in, out, out); // the input comes straight from the file
+  if (_stack) {
+    engine.useStackCode();
+  }
+  if (_jit) {
+    engine.jit();
+  }
+
+  int record;
+  while (take(worker, record)) {
+    engine.setInput(_records[record]);
+    out.str("");
+    engine.run();
+    _outputs[record] = out.str();
+    _done[record].store(true, std::memory_order_release);
+    _done[record].notify_one();
+  }
+}
+
+bool ripl::Batch::take(int worker, int &record) {
+  do {
+    Queue &queue = *_queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.next < queue.end) {
+      record = queue.next++;
+      return true;
+    }
+  } while (steal(worker));
+  return false;
+}
+
+// Moves the back half of the fullest queue over to the worker's own, which is
+// empty at this point. Returns false once there is nothing left anywhere.
+bool ripl::Batch::steal(int worker) {
+  int victim = -1;
+  int most = 0;
+  for (int i = 0; i < _queues.size(); i++) {
+    Queue &queue = *_queues[i];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.end - queue.next > most) {
+      most = queue.end - queue.next;
+      victim = i;
+    }
+  }
+  if (victim == -1) {
+    return false;
+  }
+
+  Queue &own = *_queues[worker];
+  Queue &other = *_queues[victim];
+  std::scoped_lock guard(own.lock, other.lock);
+  int left = other.end - other.next;
+  if (left > 0) {
+    int half = (left + 1) / 2;
+    own.next = other.end - half;
+    own.end = other.end;
+    other.end -= half;
+  }
+  return true;
+}
@@ -0,0 +1,185 @@
+#include "cache.hpp"
+#include "bytecode.hpp"
+#include "compiler.hpp"
+#include "mapped_file.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+static const char MAGIC[4] = {'R', 'I', 'P', 'C'};
+
+// FNV-1a, 64 bits.
+static std::uint64_t hashOf(std::string_view text) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char ch : text) {
+    hash ^= ch;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Changes whenever ripl, and with it the compiler linked into it, is
+// rebuilt: the size and modification time of the executable, or where that
+// can't be found the time this file was compiled.
+static std::uint64_t buildOf() {
+  std::error_code error;
+  std::filesystem::path self =
+      std::filesystem::read_symlink("/proc/self/exe", error);
+  if (!error) {
+    auto time = std::filesystem::last_write_time(self, error);
+    if (!error) {
+      auto size = std::filesystem::file_size(self, error);
+      if (!error) {
+        return hashOf(std::to_string(time.time_since_epoch().count()) + "-" +
+                      std::to_string(size));
+      }
+    }
+  }
+  return hashOf(__DATE__ " " __TIME__);
+}
+
+static double millisecondsOf(long microseconds) {
+  return microseconds / 1000.0;
+}
+
+static long microsecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+ripl::Cache::Cache(std::filesystem::path directory)
+    : _directory(std::move(directory)) {}
+
+// An empty RIPL_CACHE_DIR turns the cache off.
+std::filesystem::path ripl::Cache::defaultDirectory() {
+  if (const char *directory = std::getenv("RIPL_CACHE_DIR")) {
+    return directory;
+  }
+  const char *xdg = std::getenv("XDG_CACHE_HOME");
+  if (xdg != nullptr && *xdg != '\0') {
+    return std::filesystem::path(xdg) / "ripl";
+  }
+  const char *home = std::getenv("HOME");
+  if (home != nullptr && *home != '\0') {
+    return std::filesystem::path(home) / ".cache" / "ripl";
+  }
+  return {};
+}
+
+bool ripl::Cache::open(const char *script, bool report) {
+  auto start = std::chrono::steady_clock::now();
+  std::filesystem::path path;
+  std::uint64_t hash = 0;
+  long compileTime = 0;
+  {
+    MappedFile source(script);
+    if (!source.isOpen()) {
+      std::cerr << "Could not open file " << script << " for input."
+                << std::endl;
+      return false;
+    }
+    std::string_view text(source.data(), source.length());
+    hash = hashOf(text);
+    if (!_directory.empty()) {
+      path = entry(hash, text.size());
+      if (lookup(path, compileTime)) {
+        if (report) {
+          long loadTime = microsecondsSince(start);
+          std::cerr << "Cache hit for " << script << ": loaded in "
+                    << millisecondsOf(loadTime) << " ms, saved "
+                    << millisecondsOf(compileTime - loadTime) << " ms."
+                    << std::endl;
+        }
+        return true;
+      }
+    }
+  }
+
+  Compiler compiler(script);
+  if (!compiler.build()) {
+    return false;
+  }
+  _compiled = compiler.image();
+  _image = _compiled;
+  compileTime = microsecondsSince(start);
+  if (report) {
+    std::cerr << "Cache miss for " << script << ": compiled in "
+              << millisecondsOf(compileTime) << " ms." << std::endl;
+  }
+
+  // the compiler reads the script on its own, only cache what it saw.
+  MappedFile source(script);
+  if (!path.empty() && source.isOpen() &&
+      hashOf(std::string_view(source.data(), source.length())) == hash) {
+    store(path, compileTime);
+  }
+  return true;
+}
+
+// <hash of the source>-<its length>.v<bytecode version>-<build>.bc
+std::filesystem::path ripl::Cache::entry(std::uint64_t hash,
+                                         std::size_t length) {
+  std::uint64_t build = buildOf();
+  char name[80];
+  std::snprintf(name, sizeof(name), "%016llx-%zu.v%d-%08x.bc",
+                (unsigned long long)hash, length, BYTECODE_VERSION,
+                (unsigned int)(build ^ build >> 32));
+  return _directory / name;
+}
+
+// Anything that doesn't end in a stamp matching its length is not an entry.
+bool ripl::Cache::lookup(const std::filesystem::path &path,
+                         long &compileTime) {
+  auto file = std::make_unique<MappedFile>(path.c_str());
+  if (!file->isOpen() || file->length() < sizeof(Stamp)) {
+    return false;
+  }
+  Stamp stamp;
+  std::size_t length = file->length() - sizeof(Stamp);
+  std::memcpy(&stamp, file->data() + length, sizeof(Stamp));
+  if (std::memcmp(stamp.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      stamp.length != length) {
+    return false;
+  }
+  compileTime = stamp.compileTime;
+  _entry = std::move(file);
+  _image = std::string_view(_entry->data(), length);
+  return true;
+}
+
+// Failing to write an entry only means compiling again next time.
+void ripl::Cache::store(const std::filesystem::path &path, long compileTime) {
+  std::error_code error;
+  std::filesystem::create_directories(_directory, error);
+  std::filesystem::path temporary = path;
+  temporary += ".tmp" + std::to_string(std::random_device()());
+
+  Stamp stamp{};
+  std::memcpy(stamp.magic, MAGIC, sizeof(MAGIC));
+  stamp.length = _image.size();
+  stamp.compileTime = compileTime;
+  std::ofstream out(temporary, std::ios::binary);
+  out.write(_image.data(), _image.size());
+  out.write((const char *)&stamp, sizeof(stamp));
+  out.close();
+  if (!out) {
+    std::filesystem::remove(temporary, error);
+    return;
+  }
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+}
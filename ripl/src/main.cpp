@@ -1,12 +1,114 @@
+#include "batch.hpp"
+#include "cache.hpp"
 #include "engine.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+// Scripts are compiled before they are run, anything else is bytecode.
+static bool isScript(std::string_view filename) {
+  return filename.ends_with(".rpn");
+}
 
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cout << "Usage: " << argv[0] << " <scriptname>.bc" << std::endl;
+  bool map = true;
+  bool profile = false;
+  bool listing = false;
+  bool jit = false;
+  bool stack = false;
+  bool cache = true;
+  bool cacheStats = false;
+  char *batch = nullptr;
+  // hardware_concurrency() may report 0 when the count is unknown.
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int arg = 1;
+  for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++) {
+    if (std::strcmp(argv[arg], "--no-mmap") == 0) {
+      map = false;
+    } else if (std::strcmp(argv[arg], "--profile") == 0) {
+      profile = true;
+    } else if (std::strcmp(argv[arg], "--profile-listing") == 0) {
+      profile = listing = true;
+    } else if (std::strcmp(argv[arg], "--jit") == 0) {
+      jit = true;
+    } else if (std::strcmp(argv[arg], "--stack") == 0) {
+      stack = true;
+    } else if (std::strcmp(argv[arg], "--no-cache") == 0) {
+      cache = false;
+    } else if (std::strcmp(argv[arg], "--cache-stats") == 0) {
+      cacheStats = true;
+    } else if (std::strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc) {
+      batch = argv[++arg];
+    } else if (std::strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+      threads = std::atoi(argv[++arg]);
+    } else {
+      break;
+    }
+  }
+  if (arg != argc - 1 || (batch != nullptr && threads < 1)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--no-mmap] [--jit] [--stack]"
+                 " [--profile | --profile-listing]"
+                 " [--batch <inputs> [--threads <n>]]"
+                 " [--no-cache] [--cache-stats]"
+                 " <scriptname>.bc | <scriptname>.rpn"
+              << std::endl;
     return 0;
   }
-  ripl::Engine engine(argv[1]);
+
+  // a script is compiled in memory, or its image found in the cache.
+  ripl::Cache compiled(cache ? ripl::Cache::defaultDirectory() : "");
+  bool script = isScript(argv[arg]);
+  if (script && !compiled.open(argv[arg], cacheStats)) {
+    return 1;
+  }
+
+  if (batch != nullptr) {
+    std::unique_ptr<ripl::MappedFile> file;
+    std::string_view program = compiled.image();
+    if (!script) {
+      file = std::make_unique<ripl::MappedFile>(argv[arg], map);
+      program = std::string_view(file->data(), file->length());
+    }
+    ripl::MappedFile inputs(batch, map);
+    for (auto [isOpen, name] : {std::pair(script || file->isOpen(), argv[arg]),
+                                std::pair(inputs.isOpen(), batch)}) {
+      if (!isOpen) {
+        std::cerr << "Could not open file " << name << " for input."
+                  << std::endl;
+        return 1;
+      }
+    }
+    // checked once here rather than by every worker.
+    if (!ripl::Engine(program.data(), program.size()).isLoaded()) {
+      return 1;
+    }
+    ripl::Batch runner(program, inputs, threads, jit, stack);
+    runner.run(std::cout);
+    return 0;
+  }
+
+  std::unique_ptr<ripl::Engine> loaded =
+      script ? std::make_unique<ripl::Engine>(compiled.image().data(),
+                                              compiled.image().size())
+             : std::make_unique<ripl::Engine>(argv[arg], map);
+  ripl::Engine &engine = *loaded;
+  if (stack) {
+    engine.useStackCode();
+  }
+  if (profile) {
+    // the profiler counts bytecode instructions, so it always interprets.
+    engine.profile(listing);
+  } else if (jit && !engine.jit()) {
+    std::cerr << "Could not compile " << argv[arg]
+              << " to machine code, interpreting it instead." << std::endl;
+  }
   engine.run();
   return 0;
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ir.hpp"
+#include <vector>
+namespace ripl {
+// A run of instructions that control only ever enters at the first and
+// leaves after the last.
+struct BasicBlock {
+  int begin;                   // index of the first instruction
+  int end;                     // one past the last
+  std::vector<int> successors; // blocks control can go to from here
+};
+
+// The program split up into basic blocks. A call leads both to the
+// subroutine and to the instruction after it, which is where the subroutine
+// returns to, so a RET has no successors of its own. Neither have END and
+// HALT.
+class ControlFlowGraph {
+public:
+  ControlFlowGraph(const std::vector<IrInstruction> &program);
+
+  const std::vector<BasicBlock> &blocks() const { return _blocks; }
+  // false if some jump or call goes outside the program, anything might be
+  // reachable then.
+  bool complete() const { return _complete; }
+  // By block, whether control can get there from the start of the program.
+  std::vector<bool> reachable() const;
+
+private:
+  const std::vector<IrInstruction> &_program;
+  std::vector<BasicBlock> _blocks;
+  std::vector<int> _blockOf; // instruction -> block
+  bool _complete = true;
+
+  void split();
+  void connect();
+};
+} // namespace ripl
@@ -1,21 +1,29 @@
 #pragma once
 
-#include "call_frame.hpp"
 #include "instruction_set.hpp"
+#include "ir.hpp"
 #include "stack_frame.hpp"
-#include <fstream>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <vector>
 namespace ripl {
+// Compiles a script to bytecode in memory. Jumps and calls are emitted with
+// a place holder operand and the label they go to, link() fills them all out
+// once the whole program is there, so nothing is ever patched while emitting.
 class Compiler {
 public:
-  Compiler(char *filename);
+  Compiler(const char *filename, bool optimize = false, bool registers = false,
+           bool stats = false, int inlineLimit = 8);
   ~Compiler();
 
-  void compile();
+  bool compile(); // build() and save(), false if nothing could be written
+  bool build();   // only in memory, see image()
+  bool save();
 
   void emit(const unsigned char c);
   void emit(const char *bytes, int numbytes);
@@ -24,20 +32,37 @@ public:
   void emitBool(const bool value);
   void emitLong(const long value);
   void emitDouble(const double value);
-  void emitString(const std::string &s);
+  void emitString(std::string_view s);
+  void emitHeader();
+  void emitPool();
   void emitInstruction(const Instruction &instruction);
 
+  void emitJump(const Instruction &instruction, int label);
+  void patchHeader();
+
   int currentOffset();
-  void saveCurrentOffset();
-  void fillOutBreaks();
-  void fillOutContinues();
-  void fillOutExits(std::vector<int> &offsets);
+  int newLabel();
+  void bindLabel(int label);
+  int subroutine(std::string_view name);
+  bool link();
   void addClosingJump();
-  void fillOutStartingJump();
+  void addClosingCount();
 
-  void seekToOffset(int offset);
+  int slotOf(std::string_view name);
+  void inlineCalls(std::vector<IrInstruction> &program);
+  void fold(std::vector<IrInstruction> &program);
+  void specialize(std::vector<IrInstruction> &program);
+  void optimize(std::vector<IrInstruction> &program);
+  void strip(std::vector<IrInstruction> &program);
+  void fuse(std::vector<IrInstruction> &program);
+  void layout(std::vector<IrInstruction> &program);
+  void translate(std::vector<IrInstruction> &program);
+  void stats(int lines, int tokens, std::chrono::steady_clock::duration lexing,
+             std::chrono::steady_clock::duration emitting,
+             std::chrono::steady_clock::duration compiling);
 
-  std::string lastToken() { return _lastToken; }
+  std::string_view lastToken() { return _lastToken; }
+  const std::string &image() { return _out; } // once build() is done
 
   std::shared_ptr<StackFrame> currentStackFrame();
   void createStackFrame(BranchType branchType);
@@ -51,12 +76,31 @@ public:
   void addContinue();
 
 private:
-  char *_filename;
-  std::ofstream _out;
-  std::string _lastToken;
+  const char *_filename;
+  std::string _outFilename;
+  std::string _out; // the bytecode is built up in memory
+  std::string_view _lastToken; // into the source, while build() runs
+
+  // An int operand to fill out with the address of a label.
+  struct Fixup {
+    int offset;
+    int label;
+  };
+  std::vector<int> _labels; // label -> address, -1 until it is bound
+  std::vector<Fixup> _fixups;
+  bool _failed = false; // an error was reported while emitting, see link()
 
   std::stack<std::shared_ptr<StackFrame>> _buildStack; // Build Stack
-  std::map<std::string, std::shared_ptr<CallFrame>> _callMap;
+  std::map<std::string, int, std::less<>> _callMap; // subroutine -> label
+  std::map<std::string, int, std::less<>> _slots; // variable name -> slot
+  std::vector<std::string> _pool;    // string constants
+  std::map<std::string, int, std::less<>> _poolIndex;
+  int _poolOffset = 0;
+  int _registerOffset = 0;
   int _loopLevel = 0;
+  bool _optimize;
+  bool _registers;
+  bool _stats;
+  int _inlineLimit; // instructions in a subroutine, 0 never inlines
 };
 } // namespace ripl
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "instruction_set.hpp"
+#include <string>
+#include <vector>
+namespace ripl {
+// A single decoded instruction of a compiled program along with the operand
+// it carries. Passes that need to reason about the bytecode as a whole work
+// on a list of these instead of on raw bytes.
+struct IrInstruction {
+  Instruction instruction;
+  int offset; // where the instruction starts in the bytecode
+  int size;   // opcode plus operand bytes
+
+  long l = 0;
+  double d = 0;
+  bool b = false;
+  int constant = -1; // PUSHS, index into the constant pool
+  int address = -1;  // JZ, JF, JMP, DUPJZ, DECJNZ, CALL and TAILCALL
+  int target = -1;   // index of the instruction at address
+  int slot = -1;     // LOADSLOT, STORESLOT and ADDSLOTLL
+
+  bool isJump() const {
+    return instruction == Instruction::JZ || instruction == Instruction::JF ||
+           instruction == Instruction::JMP ||
+           instruction == Instruction::DUPJZ ||
+           instruction == Instruction::DECJNZ;
+  }
+  bool hasTarget() const {
+    return isJump() || instruction == Instruction::CALL ||
+           instruction == Instruction::TAILCALL;
+  }
+};
+
+// Decodes the instructions in code between the two offsets. Jump and call
+// addresses are resolved to the index of the instruction they point at.
+std::vector<IrInstruction> decode(const std::string &code, int begin, int end);
+
+// The reverse of decode. Offsets are recomputed starting at base and every
+// jump and call address is relocated to wherever its target ended up.
+std::string encode(std::vector<IrInstruction> &program, int base);
+} // namespace ripl
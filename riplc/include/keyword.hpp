@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+namespace ripl {
+// What an identifier means to the compiler, NONE for the names of variables
+// and subroutines.
+enum class Keyword : unsigned char {
+  NONE = 0,
+  ADD,        // +
+  SUB,        // -
+  MUL,        // *
+  DIV,        // /
+  MOD,        // %
+  AND,        // &&
+  OR,         // ||
+  NOT,        // !
+  EQ,         // ==
+  NEQ,        // !=
+  GT,         // >
+  LT,         // <
+  GTE,        // >=
+  LTE,        // <=
+  DUP,        // dup
+  SWAP,       // swap
+  ROTUP,      // rotup
+  ROTDN,      // rotdn
+  DROP,       // drop
+  INC,        // ++
+  DEC,        // --
+  RETURN,     // return and }
+  EXPECT,     // expect
+  END,        // end
+  PRINT,      // =
+  CALL,       // call
+  SUBROUTINE, // {
+  VAR,        // var
+  STORE,      // <-
+  LOAD,       // ->
+  IF,         // if
+  ENDIF,      // endif
+  ELSE,       // else
+  FOR,        // for
+  ENDFOR,     // endfor
+  WHILE,      // while
+  ENDWHILE,   // endwhile
+  BREAK,      // break
+  CONTINUE,   // continue
+};
+
+// Keywords are looked up in a perfect hash table built at compile time: the
+// hash only looks at the length and the first and last char, and the seed is
+// searched for so that no two keywords share a slot. A lexeme is then a
+// keyword if it is the one in its slot, a single comparison whatever it is.
+struct KeywordEntry {
+  std::string_view lexeme;
+  Keyword keyword = Keyword::NONE;
+};
+
+inline constexpr KeywordEntry KEYWORDS[] = {
+    {"+", Keyword::ADD},          {"-", Keyword::SUB},
+    {"*", Keyword::MUL},          {"/", Keyword::DIV},
+    {"%", Keyword::MOD},          {"&&", Keyword::AND},
+    {"||", Keyword::OR},          {"!", Keyword::NOT},
+    {"==", Keyword::EQ},          {"!=", Keyword::NEQ},
+    {">", Keyword::GT},           {"<", Keyword::LT},
+    {">=", Keyword::GTE},         {"<=", Keyword::LTE},
+    {"dup", Keyword::DUP},        {"swap", Keyword::SWAP},
+    {"rotup", Keyword::ROTUP},    {"rotdn", Keyword::ROTDN},
+    {"drop", Keyword::DROP},      {"++", Keyword::INC},
+    {"--", Keyword::DEC},         {"return", Keyword::RETURN},
+    {"}", Keyword::RETURN},       {"expect", Keyword::EXPECT},
+    {"end", Keyword::END},        {"=", Keyword::PRINT},
+    {"call", Keyword::CALL},      {"{", Keyword::SUBROUTINE},
+    {"var", Keyword::VAR},        {"<-", Keyword::STORE},
+    {"->", Keyword::LOAD},        {"if", Keyword::IF},
+    {"endif", Keyword::ENDIF},    {"else", Keyword::ELSE},
+    {"for", Keyword::FOR},        {"endfor", Keyword::ENDFOR},
+    {"while", Keyword::WHILE},    {"endwhile", Keyword::ENDWHILE},
+    {"break", Keyword::BREAK},    {"continue", Keyword::CONTINUE},
+};
+
+inline constexpr std::size_t KEYWORD_SLOTS = 128; // a power of two
+inline constexpr std::size_t KEYWORD_LENGTH = 8; // of the longest one
+
+constexpr std::size_t keywordHash(std::string_view lexeme, unsigned seed) {
+  unsigned hash = lexeme.size() * seed + (unsigned char)lexeme.front();
+  hash = hash * seed + (unsigned char)lexeme.back();
+  return (hash ^ (hash >> 7)) & (KEYWORD_SLOTS - 1);
+}
+
+// The first seed that puts every keyword in a slot of its own, 0 if none.
+consteval unsigned keywordSeed() {
+  for (unsigned seed = 1; seed < 10000; seed++) {
+    std::array<bool, KEYWORD_SLOTS> used{};
+    bool collides = false;
+    for (const KeywordEntry &entry : KEYWORDS) {
+      std::size_t slot = keywordHash(entry.lexeme, seed);
+      collides = collides || used[slot];
+      used[slot] = true;
+    }
+    if (!collides) {
+      return seed;
+    }
+  }
+  return 0;
+}
+
+inline constexpr unsigned KEYWORD_SEED = keywordSeed();
+static_assert(KEYWORD_SEED != 0, "no perfect hash for the keywords, add "
+                                 "slots or change keywordHash");
+
+consteval std::array<KeywordEntry, KEYWORD_SLOTS> keywordTable() {
+  std::array<KeywordEntry, KEYWORD_SLOTS> table{};
+  for (const KeywordEntry &entry : KEYWORDS) {
+    table[keywordHash(entry.lexeme, KEYWORD_SEED)] = entry;
+  }
+  return table;
+}
+
+inline constexpr std::array<KeywordEntry, KEYWORD_SLOTS> KEYWORD_TABLE =
+    keywordTable();
+
+constexpr Keyword keywordOf(std::string_view lexeme) {
+  if (lexeme.empty() || lexeme.size() > KEYWORD_LENGTH) {
+    return Keyword::NONE;
+  }
+  const KeywordEntry &entry =
+      KEYWORD_TABLE[keywordHash(lexeme, KEYWORD_SEED)];
+  return entry.lexeme == lexeme ? entry.keyword : Keyword::NONE;
+}
+
+static_assert(keywordOf("endwhile") == Keyword::ENDWHILE);
+static_assert(keywordOf("}") == Keyword::RETURN);
+static_assert(keywordOf("counter") == Keyword::NONE);
+} // namespace ripl
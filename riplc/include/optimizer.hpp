@@ -0,0 +1,65 @@
+#pragma once
+
+#include "arena.hpp"
+#include "ir.hpp"
+#include "value.hpp"
+#include <string>
+#include <vector>
+namespace ripl {
+// Optimizations working on the decoded program. While a pass runs
+// instructions are only marked as removed, a jump to a removed instruction
+// lands on the next one that survives. The targets are relocated accordingly
+// once the program is compacted at the end of the pass.
+//
+// Rules remove instructions and change jumps only through remove() and
+// retarget(), which keep the count of jumps landing on every instruction up
+// to date, so a pass stays linear in the size of the program.
+class Optimizer {
+public:
+  // Strings produced by folding are added to the constant pool.
+  Optimizer(std::vector<IrInstruction> &program,
+            std::vector<std::string> &pool);
+
+  // All return the number of instructions removed.
+  int fold();     // evaluates operators applied to literals
+  int peephole(); // removes and simplifies short instruction sequences
+  int fuse();     // combines pairs of instructions into superinstructions
+  int strip();    // removes whatever control can never get to
+
+  // Copies the bodies of subroutines of at most limit instructions into the
+  // places they are called from. Returns the number of calls replaced.
+  int inlineCalls(int limit);
+
+private:
+  typedef bool (Optimizer::*Rule)(int index);
+
+  std::vector<IrInstruction> &_program;
+  std::vector<std::string> &_pool;
+  Arena _folded; // results of folding string concatenations
+  std::vector<bool> _removed;
+  std::vector<int> _forward;  // removed -> somewhere after it, see resolve
+  std::vector<int> _backward; // removed -> somewhere before it
+  std::vector<int> _jumpsTo;  // by instruction, the jumps that land on it
+
+  int apply(Rule rule);
+  void track();
+  int resolve(int index);
+  int next(int index);
+  int previous(int index);
+  void findTargets();
+  bool isTarget(int index) { return _jumpsTo[index] > 0; }
+  void remove(int index);
+  void retarget(int index, int target);
+  int bodyEnd(int entry, int limit);
+  bool foldAt(int index);
+  bool literal(const IrInstruction &ir, Value &value);
+  void setLiteral(IrInstruction &ir, const Value &value);
+  bool evaluate(Instruction instruction, const Value &lhs, const Value &rhs,
+                Value &result);
+  bool rewrite(int index);
+  bool fuseAt(int index);
+  bool rewritePair(int index, int second);
+  bool threadJump(int index);
+  void compact();
+};
+} // namespace ripl
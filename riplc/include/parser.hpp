@@ -1,31 +1,35 @@
 #pragma once
 
+#include "mapped_file.hpp"
 #include "token.hpp"
+#include <string_view>
 #include <vector>
 namespace ripl {
+// Splits the source into tokens in a single scan over the memory mapped
+// file. Lexemes are views into the file, numbers and bools are told apart
+// from identifiers and parsed while their chars are scanned.
 class Parser {
 public:
-  Parser(char *filename);
+  Parser(const char *filename);
   ~Parser();
 
-  void build();
-  Token get() { return _tokens[_index++]; }
+  bool build(); // false if the file couldn't be read or had errors in it
+  const Token &get() { return _tokens[_index++]; }
   bool eof() { return _index >= _tokens.size(); }
   int tokenCount() { return _tokens.size(); }
+  int lineCount() { return _line - (_column == 1 ? 1 : 0); }
 
 private:
-  std::string text;
-  int _line = 0, _column = 0, _lastline, _lastcol;
-  int _pos = 0;
+  MappedFile _file;
+  const char *_pos = nullptr;
+  const char *_end = nullptr;
+  int _line = 1, _column = 1;
   int _index = 0;
+  bool _failed = false; // an error was reported
 
-  void _skipWhiteSpaces();
-  std::string _nextToken();
-  std::string _getQuotedString();
-  void _discardComments();
-  int _nextChar();
-  void _unget();
-  bool _endOfText() { return _pos >= text.length(); }
+  void _word();
+  void _quotedString();
+  void _discardComment();
 
   std::vector<Token> _tokens;
 };
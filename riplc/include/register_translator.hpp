@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ir.hpp"
+#include "register_set.hpp"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+namespace ripl {
+// Translates the stack code into register code (see register_set.hpp) by
+// running it symbolically. Every position of the data stack has a register
+// of its own, and which register holds each value on the stack is tracked at
+// compile time. Pushing a variable or a constant, DUP, SWAP, ROTUP, ROTDN
+// and DROP need no code at all, they only change that. Where control flow
+// meets, every value is moved back into the register of its position.
+//
+// This needs the depth of the stack to be the same however an instruction
+// is reached. Wherever the register code would have to do something the
+// stack code does differently (an operand of the wrong type, an error to
+// report, CALL) it leaves the rest of the run to the stack code, recording
+// which register holds each value of the stack at that point.
+class RegisterTranslator {
+public:
+  RegisterTranslator(const std::vector<IrInstruction> &program, int slots);
+
+  bool translate(); // false if the program can't be, see error()
+  std::string section(); // the register code as laid out in the file
+  int size() { return _constants.size() + _code.size(); } // instructions
+  const std::string &error() { return _error; }
+
+private:
+  enum class Kind { VARIABLE, CONSTANT, STACK, SCRATCH };
+  struct Register {
+    Kind kind;
+    int index;
+    bool operator==(const Register &other) const = default;
+  };
+  struct Op {
+    RegisterInstruction instruction;
+    std::vector<Register> registers;
+    long bits = 0;   // the constant of the loads, the stack size for END
+    int target = -1; // jumps, index of the stack instruction
+  };
+  struct Deopt {
+    int op;
+    int offset;
+    std::vector<Register> stack;
+  };
+
+  const std::vector<IrInstruction> &_program;
+  int _slots;
+  std::vector<Op> _constants; // loaded into their registers up front
+  std::map<std::pair<RegisterInstruction, long>, int> _constantIndex;
+  std::vector<Op> _code;
+  std::vector<Deopt> _deopts;
+
+  std::vector<Register> _stack; // the register of each value, bottom first
+  bool _known = true;           // false where the code is never reached
+  int _current = 0;             // the stack instruction being translated
+  int _last = -1; // the op that just wrote the top of the stack, if any
+  int _maxDepth = 0;
+  int _scratch = 0;
+  std::set<int> _targets;
+  std::map<int, int> _depths; // jump target -> depth of the stack
+  std::map<int, int> _labels; // jump target -> op
+  std::string _error;
+
+  bool step(const IrInstruction &ir);
+  bool label(int index);
+  bool reach(int target);
+  bool fail(const std::string &reason);
+  bool need(int count);
+  Register constant(RegisterInstruction load, long bits);
+  void push(Register reg);
+  Register pop();
+  void binary(RegisterInstruction instruction, bool mayLeave);
+  void unary(RegisterInstruction instruction, bool mayLeave);
+  void store(int slot, int last);
+  void materialize(Register reg);
+  void flush();
+  void leave();
+  int emit(RegisterInstruction instruction, std::vector<Register> registers,
+           long bits = 0, int target = -1);
+  int number(Register reg);
+};
+} // namespace ripl
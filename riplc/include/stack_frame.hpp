@@ -1,28 +1,29 @@
 #pragma once
 
 #include <memory>
-#include <vector>
 namespace ripl {
 enum class BranchType {
   CONDITIONAL = 0,
   LOOPING,
 };
+// An if or a loop being compiled, along with the labels (see Compiler) its
+// jumps go to: exit is where the code goes on after it, next is where a loop
+// continues.
 class StackFrame {
 public:
   StackFrame(int looplevel, BranchType branchType,
-             std::shared_ptr<StackFrame> parent)
-      : _loopLevel(looplevel), _branchType(branchType), _parent(parent) {}
-  ~StackFrame() {
-    _continues.clear();
-    _breaks.clear();
-  }
+             std::shared_ptr<StackFrame> parent, int exit, int next = -1)
+      : _parent(parent), _loopLevel(looplevel), _branchType(branchType),
+        _exit(exit), _next(next) {}
+  ~StackFrame() {}
 
-  void addToContinues(int diskOffset);
-  void addToBreaks(int diskOffset);
-  std::vector<int> fetchBreaks() { return _breaks; }
-  std::vector<int> fetchContinues() { return _continues; }
+  // The labels of the innermost loop, -1 if there is none.
+  int breakLabel();
+  int continueLabel();
 
   int loopLevel() { return _loopLevel; }
+  int exit() { return _exit; }
+  int next() { return _next; }
 
   int offset() { return _offset; }
   void offset(int offset) { _offset = offset; }
@@ -30,9 +31,9 @@ public:
 private:
   std::shared_ptr<StackFrame> _parent;
   int _loopLevel;
-  int _offset;
+  int _offset = 0; // where a loop starts
   BranchType _branchType;
-  std::vector<int> _continues; //[Offset]
-  std::vector<int> _breaks;    //[Offset]
+  int _exit;
+  int _next;
 };
 } // namespace ripl
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <string>
+#include "keyword.hpp"
+#include <string_view>
 namespace ripl {
 enum class TokenType {
   LONG,
@@ -9,12 +10,21 @@ enum class TokenType {
   STRING,
   IDENTIFIER,
 };
+// The lexeme points into the source held by the Parser, which has to outlive
+// the token. Literals come with their value already parsed, identifiers
+// with the keyword they are, if any.
 struct Token {
   TokenType type;
-  std::string lexeme;
-  int line, column;
+  std::string_view lexeme;
+  int line, column; // where the token starts, counting from 1
+  Keyword keyword = Keyword::NONE;
+  union {
+    long l;
+    double d;
+    bool b;
+  };
 
-  Token(TokenType ttype, std::string lex, int l, int col)
-      : type(ttype), lexeme(lex), line(l), column(col) {}
+  Token(TokenType ttype, std::string_view lex, int l, int col)
+      : type(ttype), lexeme(lex), line(l), column(col), l(0) {}
 };
 } // namespace ripl
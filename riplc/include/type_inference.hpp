@@ -0,0 +1,46 @@
+#pragma once
+
+#include "instruction_set.hpp"
+#include "ir.hpp"
+#include <map>
+#include <vector>
+namespace ripl {
+enum class StaticType : unsigned char {
+  NONE = 0, // nothing known yet
+  LONG,
+  DOUBLE,
+  BOOL,
+  STRING,
+  UNKNOWN, // could be anything
+};
+
+// Works out the types of the values on the data stack at every instruction
+// and replaces the generic arithmetic and comparison instructions with their
+// type-specialized forms wherever the types of both operands are known.
+//
+// Only the top of the stack is tracked, whatever lies below the tracked part
+// is unknown. An instruction the engine may or may not carry out depending
+// on the types of its operands leaves nothing tracked unless those types are
+// known. Variables get a single type for the whole program which is the join
+// of everything ever assigned to them.
+class TypeInference {
+public:
+  TypeInference(std::vector<IrInstruction> &program);
+
+  int specialize(); // returns the number of instructions rewritten
+
+private:
+  typedef std::vector<StaticType> TypeStack;
+
+  std::vector<IrInstruction> &_program;
+  std::vector<TypeStack> _states;
+  std::vector<bool> _reached;
+  std::map<int, StaticType> _variables; // by slot
+
+  void analyse();
+  void flow(int index, const TypeStack &state, std::vector<int> &worklist);
+  bool transfer(const IrInstruction &ir, TypeStack &types);
+  void assign(int slot, StaticType type);
+  Instruction specialized(const IrInstruction &ir, const TypeStack &types);
+};
+} // namespace ripl
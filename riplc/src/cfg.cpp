@@ -0,0 +1,85 @@
+#include "cfg.hpp"
+#include "instruction_set.hpp"
+#include "ir.hpp"
+#include <vector>
+
+static bool fallsThrough(ripl::Instruction instruction) {
+  return instruction != ripl::Instruction::JMP &&
+         instruction != ripl::Instruction::TAILCALL &&
+         instruction != ripl::Instruction::RET &&
+         instruction != ripl::Instruction::END &&
+         instruction != ripl::Instruction::HALT;
+}
+
+ripl::ControlFlowGraph::ControlFlowGraph(
+    const std::vector<IrInstruction> &program)
+    : _program(program) {
+  split();
+  connect();
+}
+
+// A block starts at the beginning, wherever something jumps or calls to, and
+// right after anything that jumps, calls or stops.
+void ripl::ControlFlowGraph::split() {
+  std::vector<bool> leader(_program.size() + 1, false);
+  leader[0] = true;
+  for (int i = 0; i < _program.size(); i++) {
+    const IrInstruction &ir = _program[i];
+    if (ir.hasTarget()) {
+      if (ir.target == -1) {
+        _complete = false;
+      } else {
+        leader[ir.target] = true;
+      }
+    }
+    if (ir.hasTarget() || !fallsThrough(ir.instruction)) {
+      leader[i + 1] = true;
+    }
+  }
+
+  _blockOf.resize(_program.size());
+  for (int i = 0; i < _program.size(); i++) {
+    if (leader[i]) {
+      if (!_blocks.empty()) {
+        _blocks.back().end = i;
+      }
+      _blocks.push_back(BasicBlock{i, i, {}});
+    }
+    _blockOf[i] = _blocks.size() - 1;
+  }
+  if (!_blocks.empty()) {
+    _blocks.back().end = _program.size();
+  }
+}
+
+void ripl::ControlFlowGraph::connect() {
+  for (auto &block : _blocks) {
+    const IrInstruction &last = _program[block.end - 1];
+    if (last.hasTarget() && last.target != -1) {
+      block.successors.push_back(_blockOf[last.target]);
+    }
+    if (fallsThrough(last.instruction) && block.end < _program.size()) {
+      block.successors.push_back(_blockOf[block.end]);
+    }
+  }
+}
+
+std::vector<bool> ripl::ControlFlowGraph::reachable() const {
+  std::vector<bool> reached(_blocks.size(), false);
+  std::vector<int> worklist;
+  if (!_blocks.empty()) {
+    reached[0] = true;
+    worklist.push_back(0);
+  }
+  while (!worklist.empty()) {
+    int block = worklist.back();
+    worklist.pop_back();
+    for (int successor : _blocks[block].successors) {
+      if (!reached[successor]) {
+        reached[successor] = true;
+        worklist.push_back(successor);
+      }
+    }
+  }
+  return reached;
+}
@@ -1,317 +1,391 @@
 #include "compiler.hpp"
-#include "call_frame.hpp"
+#include "bytecode.hpp"
 #include "instruction_set.hpp"
+#include "ir.hpp"
+#include "keyword.hpp"
+#include "optimizer.hpp"
 #include "parser.hpp"
+#include "register_translator.hpp"
 #include "stack_frame.hpp"
 #include "token.hpp"
-#include "utils.hpp"
+#include "type_inference.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <stack>
 #include <string>
 #include <vector>
 
-ripl::Compiler::Compiler(char *filename) : _filename(filename) {
-  int len = std::strlen(filename);
-  char *outFile = new char[len + 4];
-  strcpy(outFile, filename);
-  strcat(outFile, ".bc");
-  _out.open(outFile); // bc=byte code
-  delete[] outFile;
-
-  if (!_out) {
-    std::cerr << "could not open file for output." << std::endl;
-    return;
+// Bytes of code the program takes up once encoded.
+static int codeSize(const std::vector<ripl::IrInstruction> &program) {
+  int size = 0;
+  for (auto &ir : program) {
+    size += ripl::sizeOf(ir.instruction);
   }
+  return size;
 }
 
-ripl::Compiler::~Compiler() {
-  _out.flush();
-  _out.close();
+ripl::Compiler::Compiler(const char *filename, bool optimize, bool registers,
+                         bool stats, int inlineLimit)
+    : _filename(filename), _optimize(optimize), _registers(registers),
+      _stats(stats), _inlineLimit(inlineLimit) {
+  _outFilename = std::string(filename) + ".bc"; // bc=byte code
 }
 
-void ripl::Compiler::compile() {
+ripl::Compiler::~Compiler() {}
+
+bool ripl::Compiler::compile() { return build() && save(); }
+
+bool ripl::Compiler::build() {
+  auto start = std::chrono::steady_clock::now();
   ripl::Parser parser(_filename);
-  parser.build();
+  if (!parser.build()) {
+    std::cerr << "Could not compile " << _filename << "." << std::endl;
+    return false;
+  }
+  auto lexed = std::chrono::steady_clock::now();
 
+  emitHeader();
   while (!parser.eof()) {
-    Token t = parser.get();
+    const Token &t = parser.get();
 
     switch (t.type) {
     case TokenType::LONG: {
       emitInstruction(ripl::Instruction::PUSHL);
-      long l = std::stol(t.lexeme);
-      emitLong(l);
+      emitLong(t.l);
     } break;
     case TokenType::DOUBLE: {
       emitInstruction(ripl::Instruction::PUSHD);
-      double l = std::stod(t.lexeme);
-      emitDouble(l);
+      emitDouble(t.d);
     } break;
     case TokenType::BOOL: {
       emitInstruction(ripl::Instruction::PUSHB);
-      std::string l = ripl::toLower(t.lexeme);
-      bool truth = (l == "true");
-      emitBool(truth);
+      emitBool(t.b);
     } break;
     case TokenType::STRING: {
       emitInstruction(ripl::Instruction::PUSHS);
-      int len = t.lexeme.length();
       emitString(t.lexeme);
     } break;
     case TokenType::IDENTIFIER: {
-      if (t.lexeme == "+") {
+      switch (t.keyword) {
+      case Keyword::ADD:
         emitInstruction(Instruction::ADD);
         break;
-      }
-      if (t.lexeme == "-") {
+      case Keyword::SUB:
         emitInstruction(Instruction::SUB);
         break;
-      }
-      if (t.lexeme == "*") {
+      case Keyword::MUL:
         emitInstruction(Instruction::MUL);
         break;
-      }
-      if (t.lexeme == "/") {
+      case Keyword::DIV:
         emitInstruction(Instruction::DIV);
         break;
-      }
-      if (t.lexeme == "%") {
+      case Keyword::MOD:
         emitInstruction(Instruction::MOD);
         break;
-      }
-      if (t.lexeme == "&&") {
+      case Keyword::AND:
         emitInstruction(Instruction::AND);
         break;
-      }
-      if (t.lexeme == "||") {
+      case Keyword::OR:
         emitInstruction(Instruction::OR);
         break;
-      }
-      if (t.lexeme == "!") {
+      case Keyword::NOT:
         emitInstruction(Instruction::NOT);
         break;
-      }
-      if (t.lexeme == "==") {
+      case Keyword::EQ:
         emitInstruction(Instruction::EQ);
         break;
-      }
-      if (t.lexeme == "!=") {
+      case Keyword::NEQ:
         emitInstruction(Instruction::NEQ);
         break;
-      }
-      if (t.lexeme == ">") {
+      case Keyword::GT:
         emitInstruction(Instruction::GT);
         break;
-      }
-      if (t.lexeme == "<") {
+      case Keyword::LT:
         emitInstruction(Instruction::LT);
         break;
-      }
-      if (t.lexeme == ">=") {
+      case Keyword::GTE:
         emitInstruction(Instruction::GTE);
         break;
-      }
-      if (t.lexeme == "<=") {
+      case Keyword::LTE:
         emitInstruction(Instruction::LTE);
         break;
-      }
-      if (t.lexeme == "dup") {
+      case Keyword::DUP:
         emitInstruction(Instruction::DUP);
         break;
-      }
-      if (t.lexeme == "swap") {
+      case Keyword::SWAP:
         emitInstruction(Instruction::SWAP);
         break;
-      }
-      if (t.lexeme == "rotup") {
+      case Keyword::ROTUP:
         emitInstruction(Instruction::ROTUP);
         break;
-      }
-      if (t.lexeme == "rotdn") {
+      case Keyword::ROTDN:
         emitInstruction(Instruction::ROTDN);
         break;
-      }
-      if (t.lexeme == "drop") {
+      case Keyword::DROP:
         emitInstruction(Instruction::DROP);
         break;
-      }
-      if (t.lexeme == "++") {
+      case Keyword::INC:
         emitInstruction(Instruction::INC);
         break;
-      }
-      if (t.lexeme == "--") {
+      case Keyword::DEC:
         emitInstruction(Instruction::DEC);
         break;
-      }
-      if (t.lexeme == "return" || t.lexeme == "}") {
+      case Keyword::RETURN:
         emitInstruction(Instruction::RET);
         break;
-      }
-      if (t.lexeme == "expect") {
+      case Keyword::EXPECT:
         emitInstruction(Instruction::EXPECT);
         break;
-      }
-      if (t.lexeme == "end") {
+      case Keyword::END:
         emitInstruction(Instruction::END);
         break;
-      }
-      if (t.lexeme == "=") {
+      case Keyword::PRINT:
         emitInstruction(Instruction::PRINT);
         break;
-      }
-      // The algorithm for call-subroutine works as follows:-
-      // First a check is performed to see if the entry exists the frame is
-      // extracted then another check is performed to see if the address of the
-      // jump is -1 or not if it is then we have not yet created the subroutine
-      // so we only add the offset to the call frame to be updated later. But if
-      // it is not -1 then we have the address of the subroutine so we update
-      // the call. If the entry does not exist we simply create a new one and
-      // add the current disk address to it.
-      if (t.lexeme == "call") {
-        emitInstruction(Instruction::CALL);
-        if (_callMap.contains(_lastToken)) {
-          auto frame = _callMap[_lastToken];
-          if (frame->address() == -1) {
-            frame->addCall(currentOffset());
-            emitInt(0);
-          } else {
-            emitInt(frame->address());
-          }
+      // Subroutines can be called before they are defined, and from within
+      // themselves, the call only needs the label of the subroutine.
+      case Keyword::CALL:
+        emitJump(Instruction::CALL, subroutine(_lastToken));
+        break;
+      case Keyword::SUBROUTINE: {
+        int label = subroutine(_lastToken);
+        if (_labels[label] != -1) {
+          std::cerr << "The subroutine " << _lastToken << " on line " << t.line
+                    << " is already defined." << std::endl;
+          _failed = true;
           break;
         }
-        CallFrame frame;
-        std::shared_ptr<CallFrame> ptr = std::make_shared<CallFrame>(frame);
-        ptr->addCall(currentOffset());
-        _callMap.insert({_lastToken, ptr});
-        emitInt(0); // emit a place holder int. this will be overwritten later
-                    // using the disk offset above.
-        break;
-      }
-      // the logic of the following token is as follows:-
-      // if the entry for the _lastToken exists we have at least one call
-      // registered. We then loop through the list and add the current offset of
-      // the instruction we also set the address feld in the frame so we can use
-      // it for later calls. In case the entry doesn't exist we create a new one
-      // and set the address.
-      if (t.lexeme == "{") {
-        if (_callMap.contains(_lastToken)) {
-          auto frame = _callMap[_lastToken];
-          int currAddr = currentOffset();
-          for (int offset : frame->getCalls()) {
-            seekToOffset(offset);
-            emitInt(currAddr);
-          }
-          seekToOffset(currAddr);
-        } else {
-          CallFrame frame;
-          frame.address(currentOffset() - 1);
-          std::shared_ptr<CallFrame> ptr = std::make_shared<CallFrame>(frame);
-          _callMap.insert({_lastToken, ptr});
-        }
-
+        bindLabel(label);
         break;
       }
-      if (t.lexeme == "var") {
-        emitInstruction(Instruction::VAR);
-        emitString(_lastToken);
+      // Variables are resolved to slots right here, a declaration only
+      // reserves the slot since every slot starts out as 0 in the VM.
+      case Keyword::VAR:
+        slotOf(_lastToken);
         break;
-      }
-      if (t.lexeme == "<-") {
-        emitInstruction(Instruction::ASSIGN);
-        emitString(_lastToken);
+      case Keyword::STORE:
+        emitInstruction(Instruction::STORESLOT);
+        emitInt(slotOf(_lastToken));
         break;
-      }
-      if (t.lexeme == "->") {
-        emitInstruction(Instruction::DEREF);
-        emitString(_lastToken);
+      case Keyword::LOAD:
+        emitInstruction(Instruction::LOADSLOT);
+        emitInt(slotOf(_lastToken));
         break;
-      }
-      if (t.lexeme == "if") {
+      case Keyword::IF:
         createStackFrame(BranchType::CONDITIONAL);
-        emitInstruction(Instruction::JF);
-        saveCurrentOffset();
-        emitInt(0);
+        emitJump(Instruction::JF, currentStackFrame()->exit());
         break;
-      }
-      if (t.lexeme == "endif") {
-        int curr = currentOffset();
-        auto frame = currentStackFrame();
-        seekToOffset(frame->offset());
-        emitInt(curr);
-        seekToOffset(curr);
+      case Keyword::ENDIF:
+        bindLabel(currentStackFrame()->exit());
         dropStackFrame();
         break;
-      }
-      if (t.lexeme == "else") {
+      case Keyword::ELSE: {
         auto frame = currentStackFrame();
         dropStackFrame();
         createStackFrame(BranchType::CONDITIONAL);
-        emitInstruction(Instruction::JMP);
-        saveCurrentOffset();
-        emitInt(0);
-        int diskOffset = currentOffset();
-        seekToOffset(frame->offset());
-        emitInt(diskOffset);
-        seekToOffset(diskOffset);
+        emitJump(Instruction::JMP, currentStackFrame()->exit());
+        bindLabel(frame->exit());
         break;
       }
-      if (t.lexeme == "for") {
-        emitInstruction(Instruction::DUP);
-        startLoop(Instruction::JZ);
+      case Keyword::FOR:
+        startLoop(Instruction::DUPJZ);
         break;
-      }
-      if (t.lexeme == "endfor") {
-        fillOutContinues();
-        emitInstruction(Instruction::DEC);
-        emitInstruction(Instruction::DUP);
-        addClosingJump();
-        fillOutStartingJump();
-        fillOutBreaks();
+      case Keyword::ENDFOR:
+        bindLabel(currentStackFrame()->next());
+        addClosingCount();
+        bindLabel(currentStackFrame()->exit());
         closeLoop();
         break;
-      }
-      if (t.lexeme == "while") {
+      case Keyword::WHILE:
         startLoop(Instruction::JF);
         break;
-      }
-      if (t.lexeme == "endwhile") {
-        fillOutContinues();
+      case Keyword::ENDWHILE:
+        bindLabel(currentStackFrame()->next());
         addClosingJump();
-        fillOutStartingJump();
-        fillOutBreaks();
+        bindLabel(currentStackFrame()->exit());
         closeLoop();
         break;
-      }
-      if (t.lexeme == "break") {
-        emitInstruction(Instruction::JMP);
+      case Keyword::BREAK:
         addBreak();
-        emitInt(0);
         break;
-      }
-      if (t.lexeme == "continue") {
-        emitInstruction(Instruction::JMP);
+      case Keyword::CONTINUE:
         addContinue();
-        emitInt(0);
+        break;
+      case Keyword::NONE:
+        _lastToken = t.lexeme;
         break;
       }
-      _lastToken = t.lexeme;
-    }
+    } break;
     }
   }
+  emitInstruction(Instruction::HALT);
+  if (!link()) {
+    std::cerr << "Could not compile " << _filename << "." << std::endl;
+    return false;
+  }
+  auto emitted = std::chrono::steady_clock::now();
+
+  auto program = ripl::decode(_out, sizeof(BytecodeHeader), currentOffset());
+  if (_optimize && _inlineLimit > 0) {
+    inlineCalls(program);
+  }
+  fold(program);
+  specialize(program);
+  if (_optimize) {
+    optimize(program);
+    strip(program);
+  }
+  fuse(program);
+  layout(program);
+
+  if (_stats) {
+    auto done = std::chrono::steady_clock::now();
+    stats(parser.lineCount(), parser.tokenCount(), lexed - start,
+          emitted - lexed, done - start);
+  }
+  return true;
+}
+
+bool ripl::Compiler::save() {
+  std::ofstream out(_outFilename, std::ios::binary);
+  if (!out) {
+    std::cerr << "could not open file for output." << std::endl;
+    return false;
+  }
+  out.write(_out.data(), _out.length());
+  return true;
+}
+
+// Lines per second of the lexer, of turning the tokens into stack code and
+// of the whole compilation.
+void ripl::Compiler::stats(int lines, int tokens,
+                           std::chrono::steady_clock::duration lexing,
+                           std::chrono::steady_clock::duration emitting,
+                           std::chrono::steady_clock::duration compiling) {
+  auto report = [lines](const char *what,
+                        std::chrono::steady_clock::duration time) {
+    double seconds = std::chrono::duration<double>(time).count();
+    std::cout << what << " took " << seconds * 1000 << " ms, "
+              << (seconds > 0 ? lines / seconds : 0) << " lines/s."
+              << std::endl;
+  };
+  std::cout << "Stats: " << lines << " lines, " << tokens << " tokens."
+            << std::endl;
+  report("Lexing", lexing);
+  report("Emitting", emitting);
+  report("Compiling", compiling);
+}
+
+// Copies small subroutines into the places they are called from. Besides
+// the call and return this saves, the passes after it get to see through
+// what used to be a call, which to type inference was the end of all it knew
+// about the stack.
+void ripl::Compiler::inlineCalls(std::vector<IrInstruction> &program) {
+  int calls = std::count_if(program.begin(), program.end(), [](auto &ir) {
+    return ir.instruction == Instruction::CALL;
+  });
+  Optimizer optimizer(program, _pool);
+  int replaced = optimizer.inlineCalls(_inlineLimit);
+  std::cout << "Inlining: replaced " << replaced << " of " << calls
+            << " calls." << std::endl;
+}
+
+// Evaluates operators applied to literals at compile time, which also leaves
+// more operand types known to specialize.
+void ripl::Compiler::fold(std::vector<IrInstruction> &program) {
+  Optimizer optimizer(program, _pool);
+  optimizer.fold();
+}
+
+// Rewrites generic arithmetic and comparisons whose operand types are known
+// into their specialized forms.
+void ripl::Compiler::specialize(std::vector<IrInstruction> &program) {
+  TypeInference inference(program);
+  inference.specialize();
+}
+
+void ripl::Compiler::optimize(std::vector<IrInstruction> &program) {
+  int before = program.size();
+  Optimizer optimizer(program, _pool);
+  int removed = optimizer.peephole();
+  std::cout << "Peephole: removed " << removed << " of " << before
+            << " instructions." << std::endl;
+}
+
+// Drops unreachable code, which after inlining and the peephole pass can be
+// whole subroutines and branches.
+void ripl::Compiler::strip(std::vector<IrInstruction> &program) {
+  int before = program.size();
+  int bytes = codeSize(program);
+  Optimizer optimizer(program, _pool);
+  int removed = optimizer.strip();
+  std::cout << "Dead code: removed " << removed << " of " << before
+            << " instructions, " << bytes - codeSize(program) << " of "
+            << bytes << " bytes." << std::endl;
+}
+
+// Replaces common pairs of instructions with superinstructions. This comes
+// last as none of the other passes know about them.
+void ripl::Compiler::fuse(std::vector<IrInstruction> &program) {
+  Optimizer optimizer(program, _pool);
+  optimizer.fuse();
+}
+
+// Lays out the final image: the header, the (re-encoded) code, the pool and
+// the register code if asked for.
+void ripl::Compiler::layout(std::vector<IrInstruction> &program) {
+  std::string code = ripl::encode(program, sizeof(BytecodeHeader));
+  _poolOffset = sizeof(BytecodeHeader) + code.length();
+
+  _out.clear();
+  emitHeader();
+  emit(code.data(), code.length());
+  emitPool();
+  if (_registers) {
+    translate(program);
+  }
 }
 
-void ripl::Compiler::emit(const unsigned char c) { _out.put(c); }
+// The register code is added after the pool, the header is written again to
+// point at it. The stack code stays as it is for the engine to fall back on.
+void ripl::Compiler::translate(std::vector<IrInstruction> &program) {
+  RegisterTranslator translator(program, _slots.size());
+  if (!translator.translate()) {
+    std::cout << "Registers: " << translator.error()
+              << ", only writing the stack code." << std::endl;
+    return;
+  }
+  std::cout << "Registers: " << translator.size() << " instructions for "
+            << program.size() << " stack instructions." << std::endl;
+
+  std::string section = translator.section();
+  _registerOffset = currentOffset();
+  emit(section.data(), section.length());
+  patchHeader();
+}
+
+void ripl::Compiler::emit(const unsigned char c) { _out.push_back(c); }
 
 void ripl::Compiler::emit(const char *bytes, int len) {
-  _out.write(bytes, len);
+  _out.append(bytes, len);
 }
 
 void ripl::Compiler::emitInstruction(const ripl::Instruction &instruction) {
   emit((unsigned char)instruction);
 }
 
+// The operand is filled out by link().
+void ripl::Compiler::emitJump(const ripl::Instruction &instruction,
+                              int label) {
+  emitInstruction(instruction);
+  _fixups.push_back(Fixup{currentOffset(), label});
+  emitInt(0);
+}
+
 void ripl::Compiler::emitLength(const int len) { emitInt(len); }
 
 void ripl::Compiler::emitInt(const int value) {
@@ -330,25 +404,102 @@ void ripl::Compiler::emitBool(const bool value) {
   emit((char *)&value, sizeof(bool));
 }
 
-void ripl::Compiler::emitString(const std::string &value) {
-  int len = value.length();
-  char *bytes = new char[len + 1];
-  std::strcpy(bytes, value.c_str());
-  emitLength(len);
-  _out.write(bytes, len);
-  delete[] bytes;
+// Strings go into the constant pool once, the code only refers to them by
+// their index in the pool.
+void ripl::Compiler::emitString(std::string_view value) {
+  auto itr = _poolIndex.find(value);
+  if (itr != _poolIndex.end()) {
+    emitInt(itr->second);
+    return;
+  }
+  int index = _pool.size();
+  _pool.emplace_back(value);
+  _poolIndex.emplace(value, index);
+  emitInt(index);
+}
+
+// While compiling this is only a place holder so the offsets of the code
+// come out right, the real header is written once the program is final.
+void ripl::Compiler::emitHeader() {
+  BytecodeHeader header =
+      makeHeader(_slots.size(), _poolOffset, _registerOffset);
+  emit((char *)&header, sizeof(header));
+}
+
+// Writes the header over the one at the start of the image.
+void ripl::Compiler::patchHeader() {
+  BytecodeHeader header =
+      makeHeader(_slots.size(), _poolOffset, _registerOffset);
+  std::memcpy(_out.data(), &header, sizeof(header));
+}
+
+void ripl::Compiler::emitPool() {
+  emitLength(_pool.size());
+  for (auto &s : _pool) {
+    emitLength(s.length());
+    emit(s.data(), s.length());
+  }
+}
+
+int ripl::Compiler::currentOffset() { return _out.size(); }
+
+int ripl::Compiler::newLabel() {
+  _labels.push_back(-1);
+  return _labels.size() - 1;
+}
+
+void ripl::Compiler::bindLabel(int label) { _labels[label] = currentOffset(); }
+
+// The label of the named subroutine, made up on the first call or definition.
+int ripl::Compiler::subroutine(std::string_view name) {
+  auto itr = _callMap.find(name);
+  if (itr != _callMap.end()) {
+    return itr->second;
+  }
+  int label = newLabel();
+  _callMap.emplace(name, label);
+  return label;
 }
 
-int ripl::Compiler::currentOffset() { return _out.tellp(); }
+// Fills out every jump and call with the address of its label, false if one
+// of them goes nowhere or anything else went wrong while emitting.
+bool ripl::Compiler::link() {
+  bool linked = !_failed;
+  for (auto &[name, label] : _callMap) {
+    if (_labels[label] == -1) {
+      std::cerr << "The subroutine " << name << " is called but never defined."
+                << std::endl;
+      linked = false;
+    }
+  }
+  if (!_buildStack.empty()) {
+    std::cerr << "Reached the end with an if or a loop still open."
+              << std::endl;
+    linked = false;
+  }
+  for (const Fixup &fixup : _fixups) {
+    if (fixup.label == -1 || _labels[fixup.label] == -1) {
+      linked = false;
+      continue;
+    }
+    std::memcpy(_out.data() + fixup.offset, &_labels[fixup.label],
+                sizeof(int));
+  }
+  return linked;
+}
 
 std::shared_ptr<ripl::StackFrame> ripl::Compiler::currentStackFrame() {
   auto frame = _buildStack.top();
   return frame;
 }
 
+// Loops get a label to continue at as well as the one to exit to.
 void ripl::Compiler::createStackFrame(ripl::BranchType branchType) {
+  int exit = newLabel();
+  int next = branchType == BranchType::LOOPING ? newLabel() : -1;
   StackFrame frame(loopLevel(), branchType,
-                   _buildStack.size() == 0 ? nullptr : _buildStack.top());
+                   _buildStack.size() == 0 ? nullptr : _buildStack.top(), exit,
+                   next);
   std::shared_ptr<StackFrame> ptr = std::make_shared<StackFrame>(frame);
   _buildStack.push(ptr);
 }
@@ -367,49 +518,29 @@ void ripl::Compiler::closeLoop() {
 
 void ripl::Compiler::startLoop(ripl::Instruction instruction) {
   openNewLoop();
-  saveCurrentOffset();
-  emitInstruction(instruction);
-  emitInt(0);
+  auto frame = currentStackFrame();
+  frame->offset(currentOffset());
+  emitJump(instruction, frame->exit());
 }
 
 int ripl::Compiler::loopLevel() { return _loopLevel; }
 
 void ripl::Compiler::addBreak() {
-  auto frame = currentStackFrame();
-  frame->addToBreaks(currentOffset());
+  emitJump(Instruction::JMP, currentStackFrame()->breakLabel());
 }
 
 void ripl::Compiler::addContinue() {
-  auto frame = currentStackFrame();
-  frame->addToContinues(currentOffset());
-}
-
-void ripl::Compiler::saveCurrentOffset() {
-  auto frame = currentStackFrame();
-  frame->offset(currentOffset());
-}
-
-void ripl::Compiler::seekToOffset(int offset) { _out.seekp(offset); }
-
-void ripl::Compiler::fillOutContinues() {
-  auto frame = _buildStack.top();
-  auto continues = frame->fetchContinues();
-  fillOutExits(continues);
-}
-
-void ripl::Compiler::fillOutBreaks() {
-  auto frame = _buildStack.top();
-  auto breaks = frame->fetchBreaks();
-  fillOutExits(breaks);
+  emitJump(Instruction::JMP, currentStackFrame()->continueLabel());
 }
 
-void ripl::Compiler::fillOutExits(std::vector<int> &offsets) {
-  int pos = currentOffset();
-  for (int diskoffset : offsets) {
-    seekToOffset(diskoffset);
-    emitInt(pos);
+int ripl::Compiler::slotOf(std::string_view name) {
+  auto itr = _slots.find(name);
+  if (itr != _slots.end()) {
+    return itr->second;
   }
-  seekToOffset(pos);
+  int slot = _slots.size();
+  _slots.emplace(name, slot);
+  return slot;
 }
 
 void ripl::Compiler::addClosingJump() {
@@ -418,11 +549,10 @@ void ripl::Compiler::addClosingJump() {
   emitInt(frame->offset());
 }
 
-void ripl::Compiler::fillOutStartingJump() {
+// Counts down and goes straight back to the body of a for loop, skipping the
+// DUPJZ at its head which only needs to run on entry.
+void ripl::Compiler::addClosingCount() {
   auto frame = currentStackFrame();
-  int pos = currentOffset();
-  seekToOffset(frame->offset() +
-               1); // skip the instruction and get to the address
-  emitInt(pos);
-  seekToOffset(pos);
+  emitInstruction(Instruction::DECJNZ);
+  emitInt(frame->offset() + 1 + sizeof(int));
 }
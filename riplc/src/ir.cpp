@@ -0,0 +1,124 @@
+#include "ir.hpp"
+#include "instruction_set.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+template <typename T> static void writeOperand(std::string &code, T value) {
+  code.append((char *)&value, sizeof(T));
+}
+
+template <typename T> static T readOperand(const std::string &code, int &pos) {
+  T value;
+  std::memcpy((char *)&value, code.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return value;
+}
+
+std::vector<ripl::IrInstruction> ripl::decode(const std::string &code,
+                                              int begin, int end) {
+  std::vector<IrInstruction> program;
+  int pos = begin;
+  while (pos < end) {
+    IrInstruction ir;
+    ir.offset = pos;
+    ir.instruction = (Instruction)code[pos++];
+
+    switch (ir.instruction) {
+    case Instruction::PUSHL:
+    case Instruction::ADDL:
+      ir.l = readOperand<long>(code, pos);
+      break;
+    case Instruction::PUSHD:
+      ir.d = readOperand<double>(code, pos);
+      break;
+    case Instruction::PUSHB:
+      ir.b = readOperand<bool>(code, pos);
+      break;
+    case Instruction::PUSHS:
+      ir.constant = readOperand<int>(code, pos);
+      break;
+    case Instruction::JZ:
+    case Instruction::JF:
+    case Instruction::JMP:
+    case Instruction::DUPJZ:
+    case Instruction::DECJNZ:
+    case Instruction::CALL:
+    case Instruction::TAILCALL:
+      ir.address = readOperand<int>(code, pos);
+      break;
+    case Instruction::LOADSLOT:
+    case Instruction::STORESLOT:
+    case Instruction::ADDSLOTLL:
+      ir.slot = readOperand<int>(code, pos);
+      break;
+    default:
+      break;
+    }
+
+    ir.size = pos - ir.offset;
+    program.push_back(ir);
+  }
+
+  std::vector<int> index(end - begin + 1, -1); // offset - begin -> instruction
+  for (int i = 0; i < program.size(); i++) {
+    index[program[i].offset - begin] = i;
+  }
+  for (auto &ir : program) {
+    if (ir.hasTarget() && ir.address >= begin && ir.address <= end) {
+      ir.target = index[ir.address - begin];
+    }
+  }
+  return program;
+}
+
+std::string ripl::encode(std::vector<IrInstruction> &program, int base) {
+  int offset = base;
+  for (auto &ir : program) {
+    ir.offset = offset;
+    ir.size = sizeOf(ir.instruction);
+    offset += ir.size;
+  }
+  for (auto &ir : program) {
+    if (ir.hasTarget() && ir.target != -1) {
+      ir.address = program[ir.target].offset;
+    }
+  }
+
+  std::string code;
+  for (auto &ir : program) {
+    code.push_back((char)ir.instruction);
+    switch (ir.instruction) {
+    case Instruction::PUSHL:
+    case Instruction::ADDL:
+      writeOperand(code, ir.l);
+      break;
+    case Instruction::PUSHD:
+      writeOperand(code, ir.d);
+      break;
+    case Instruction::PUSHB:
+      writeOperand(code, ir.b);
+      break;
+    case Instruction::PUSHS:
+      writeOperand(code, ir.constant);
+      break;
+    case Instruction::JZ:
+    case Instruction::JF:
+    case Instruction::JMP:
+    case Instruction::DUPJZ:
+    case Instruction::DECJNZ:
+    case Instruction::CALL:
+    case Instruction::TAILCALL:
+      writeOperand(code, ir.address);
+      break;
+    case Instruction::LOADSLOT:
+    case Instruction::STORESLOT:
+    case Instruction::ADDSLOTLL:
+      writeOperand(code, ir.slot);
+      break;
+    default:
+      break;
+    }
+  }
+  return code;
+}
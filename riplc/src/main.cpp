@@ -1,13 +1,34 @@
 #include "compiler.hpp"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char *argv[]) {
-  if (argc < 2) {
-    std::cout << "Usage " << argv[0] << " <filename>" << std::endl;
+  bool optimize = false;
+  bool registers = false;
+  bool stats = false;
+  int inlineLimit = 8;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    if (std::strcmp(argv[arg], "-O") == 0) {
+      optimize = true;
+    } else if (std::strcmp(argv[arg], "--registers") == 0) {
+      registers = true;
+    } else if (std::strcmp(argv[arg], "--stats") == 0) {
+      stats = true;
+    } else if (std::strcmp(argv[arg], "--inline") == 0 && arg + 1 < argc) {
+      inlineLimit = std::atoi(argv[++arg]);
+    } else {
+      break;
+    }
+  }
+  if (arg >= argc) {
+    std::cout << "Usage " << argv[0]
+              << " [-O [--inline <n>]] [--registers] [--stats] <filename>"
+              << std::endl;
     return 0;
   }
-  ripl::Compiler compiler(argv[1]);
-  compiler.compile();
-
-  return 0;
+  ripl::Compiler compiler(argv[arg], optimize, registers, stats,
+                          inlineLimit);
+  return compiler.compile() ? 0 : 1;
 }
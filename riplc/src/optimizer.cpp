@@ -0,0 +1,505 @@
+#include "optimizer.hpp"
+#include "cfg.hpp"
+#include "instruction_set.hpp"
+#include "ir.hpp"
+#include "value.hpp"
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+
+static bool isPush(ripl::Instruction instruction) {
+  return instruction == ripl::Instruction::PUSHL ||
+         instruction == ripl::Instruction::PUSHD ||
+         instruction == ripl::Instruction::PUSHB ||
+         instruction == ripl::Instruction::PUSHS ||
+         instruction == ripl::Instruction::LOADSLOT;
+}
+
+ripl::Optimizer::Optimizer(std::vector<IrInstruction> &program,
+                           std::vector<std::string> &pool)
+    : _program(program), _pool(pool) {}
+
+int ripl::Optimizer::fold() { return apply(&Optimizer::foldAt); }
+
+int ripl::Optimizer::peephole() { return apply(&Optimizer::rewrite); }
+
+int ripl::Optimizer::fuse() { return apply(&Optimizer::fuseAt); }
+
+// Whole blocks at a time: code after a jump or END that nothing jumps to, and
+// subroutines that are never called, or no longer since they were inlined.
+// Nothing that stays can go to what is removed, so compacting leaves every
+// target where it was.
+int ripl::Optimizer::strip() {
+  ControlFlowGraph graph(_program);
+  if (!graph.complete()) {
+    return 0;
+  }
+  int before = _program.size();
+  track();
+  findTargets();
+  auto reached = graph.reachable();
+  for (int i = 0; i < graph.blocks().size(); i++) {
+    if (!reached[i]) {
+      const BasicBlock &block = graph.blocks()[i];
+      for (int j = block.begin; j < block.end; j++) {
+        remove(j);
+      }
+    }
+  }
+  compact();
+  return before - _program.size();
+}
+
+// Keeps applying the rule to every instruction until nothing changes.
+int ripl::Optimizer::apply(Rule rule) {
+  int before = _program.size();
+  track();
+
+  bool changed;
+  do {
+    changed = false;
+    findTargets();
+    for (int i = 0; i < _program.size(); i++) {
+      if (!_removed[i] && (this->*rule)(i)) {
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  compact();
+  return before - _program.size();
+}
+
+// Starts over with nothing removed.
+void ripl::Optimizer::track() {
+  _removed.assign(_program.size(), false);
+  _forward.resize(_program.size());
+  _backward.resize(_program.size());
+}
+
+// The instruction that actually runs when control reaches index. Every
+// removed instruction points further ahead, the chains followed are cut
+// short to where they end so the next time takes a single step.
+int ripl::Optimizer::resolve(int index) {
+  int end = index;
+  while (end < _program.size() && _removed[end]) {
+    end = _forward[end];
+  }
+  while (index != end) {
+    int next = _forward[index];
+    _forward[index] = end;
+    index = next;
+  }
+  return end;
+}
+
+int ripl::Optimizer::next(int index) { return resolve(index + 1); }
+
+int ripl::Optimizer::previous(int index) {
+  int start = index - 1;
+  while (start >= 0 && _removed[start]) {
+    start = _backward[start];
+  }
+  for (index--; index != start;) {
+    int previous = _backward[index];
+    _backward[index] = start;
+    index = previous;
+  }
+  return start;
+}
+
+void ripl::Optimizer::findTargets() {
+  _jumpsTo.assign(_program.size() + 1, 0);
+  for (int i = 0; i < _program.size(); i++) {
+    if (!_removed[i] && _program[i].target != -1) {
+      _jumpsTo[resolve(_program[i].target)]++;
+    }
+  }
+}
+
+// Jumps to the instruction land on the next one from now on.
+void ripl::Optimizer::remove(int index) {
+  IrInstruction &ir = _program[index];
+  if (ir.target != -1) {
+    _jumpsTo[resolve(ir.target)]--;
+  }
+  _removed[index] = true;
+  _forward[index] = index + 1;
+  _backward[index] = index - 1;
+  _jumpsTo[resolve(index)] += _jumpsTo[index];
+  _jumpsTo[index] = 0;
+}
+
+void ripl::Optimizer::retarget(int index, int target) {
+  IrInstruction &ir = _program[index];
+  if (ir.target != -1) {
+    _jumpsTo[resolve(ir.target)]--;
+  }
+  ir.target = target;
+  if (target != -1) {
+    _jumpsTo[resolve(target)]++;
+  }
+}
+
+// Replaces an operator whose operands are all pushed by the instructions
+// right before it with a push of the result. Nothing may jump in between, so
+// only the first of the pushes may be a jump target.
+bool ripl::Optimizer::foldAt(int index) {
+  IrInstruction &ir = _program[index];
+  if (isTarget(index)) {
+    return false;
+  }
+
+  int rhsIndex = previous(index);
+  Value rhs;
+  if (rhsIndex < 0 || !literal(_program[rhsIndex], rhs)) {
+    return false;
+  }
+
+  Value result;
+  if (ir.instruction == Instruction::NOT) {
+    if (rhs.type != ValueType::BOOL) {
+      return false;
+    }
+    setLiteral(_program[rhsIndex], Value(!rhs.b));
+    remove(index);
+    return true;
+  }
+
+  int lhsIndex = previous(rhsIndex);
+  Value lhs;
+  if (lhsIndex < 0 || isTarget(rhsIndex) ||
+      !literal(_program[lhsIndex], lhs) ||
+      !evaluate(ir.instruction, lhs, rhs, result)) {
+    return false;
+  }
+  setLiteral(_program[lhsIndex], result);
+  remove(rhsIndex);
+  remove(index);
+  return true;
+}
+
+bool ripl::Optimizer::literal(const IrInstruction &ir, Value &value) {
+  switch (ir.instruction) {
+  case Instruction::PUSHL:
+    value = Value(ir.l);
+    return true;
+  case Instruction::PUSHD:
+    value = Value(ir.d);
+    return true;
+  case Instruction::PUSHB:
+    value = Value(ir.b);
+    return true;
+  case Instruction::PUSHS:
+    value = Value(std::string_view(_pool[ir.constant]));
+    return true;
+  default:
+    return false;
+  }
+}
+
+void ripl::Optimizer::setLiteral(IrInstruction &ir, const Value &value) {
+  switch (value.type) {
+  case ValueType::LONG:
+    ir.instruction = Instruction::PUSHL;
+    ir.l = value.l;
+    break;
+  case ValueType::DOUBLE:
+    ir.instruction = Instruction::PUSHD;
+    ir.d = value.d;
+    break;
+  case ValueType::BOOL:
+    ir.instruction = Instruction::PUSHB;
+    ir.b = value.b;
+    break;
+  case ValueType::STRING: {
+    ir.instruction = Instruction::PUSHS;
+    auto found = std::find(_pool.begin(), _pool.end(), value.str());
+    ir.constant = found - _pool.begin();
+    if (found == _pool.end()) {
+      _pool.emplace_back(value.str());
+    }
+  } break;
+  }
+}
+
+// Does what the engine would do at run time. Returns false for anything that
+// would fail there, which is then left for the engine to report.
+bool ripl::Optimizer::evaluate(Instruction instruction, const Value &lhs,
+                               const Value &rhs, Value &result) {
+  switch (instruction) {
+  case Instruction::ADD: {
+    if (ripl::arithmetic(lhs, rhs, std::plus<>(), result)) {
+      return true;
+    }
+    // kept aside until setLiteral adds it to the pool.
+    return ripl::concatenate(lhs, rhs, _folded, result);
+  }
+  case Instruction::SUB:
+    return ripl::arithmetic(lhs, rhs, std::minus<>(), result);
+  case Instruction::MUL:
+    return ripl::arithmetic(lhs, rhs, std::multiplies<>(), result);
+  case Instruction::DIV:
+    return ripl::arithmetic(
+        lhs, rhs, [](auto lhs, auto rhs) { return (double)lhs / rhs; },
+        result);
+  case Instruction::MOD:
+    // division by zero is left to fail at run time.
+    if (lhs.type != ValueType::LONG || rhs.type != ValueType::LONG ||
+        rhs.l == 0 || rhs.l == -1) {
+      return false;
+    }
+    result = Value(lhs.l % rhs.l);
+    return true;
+  case Instruction::AND:
+  case Instruction::OR:
+    if (lhs.type != ValueType::BOOL || rhs.type != ValueType::BOOL) {
+      return false;
+    }
+    result = Value(instruction == Instruction::AND ? lhs.b && rhs.b
+                                                   : lhs.b || rhs.b);
+    return true;
+  case Instruction::EQ:
+    result = Value(ripl::compare(lhs, rhs, std::equal_to<>()));
+    return true;
+  case Instruction::NEQ:
+    result = Value(ripl::compare(lhs, rhs, std::not_equal_to<>()));
+    return true;
+  case Instruction::GT:
+    result = Value(ripl::compare(lhs, rhs, std::greater<>()));
+    return true;
+  case Instruction::LT:
+    result = Value(ripl::compare(lhs, rhs, std::less<>()));
+    return true;
+  case Instruction::GTE:
+    result = Value(ripl::compare(lhs, rhs, std::greater_equal<>()));
+    return true;
+  case Instruction::LTE:
+    result = Value(ripl::compare(lhs, rhs, std::less_equal<>()));
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool ripl::Optimizer::rewrite(int index) {
+  IrInstruction &ir = _program[index];
+
+  if (ir.isJump() && threadJump(index)) {
+    return true;
+  }
+  // a jump to the very next instruction does nothing.
+  if (ir.instruction == Instruction::JMP && ir.target != -1 &&
+      resolve(ir.target) == next(index)) {
+    remove(index);
+    return true;
+  }
+
+  int second = next(index);
+  if (second >= _program.size() || isTarget(second)) {
+    return false;
+  }
+  return rewritePair(index, second);
+}
+
+// Rewrites two adjacent instructions, the second of which is known not to be
+// the target of any jump.
+bool ripl::Optimizer::rewritePair(int index, int second) {
+  IrInstruction &first = _program[index];
+  IrInstruction &ir = _program[second];
+  Instruction a = first.instruction;
+  Instruction b = ir.instruction;
+
+  // pairs that cancel each other out.
+  if ((a == Instruction::DUP && b == Instruction::DROP) ||
+      (a == Instruction::SWAP && b == Instruction::SWAP) ||
+      (a == Instruction::ROTUP && b == Instruction::ROTDN) ||
+      (a == Instruction::ROTDN && b == Instruction::ROTUP) ||
+      (isPush(a) && b == Instruction::DROP)) {
+    remove(index);
+    remove(second);
+    return true;
+  }
+
+  // adding or subtracting 1 from a long.
+  if (a == Instruction::PUSHL && first.l == 1 &&
+      (b == Instruction::ADDLL || b == Instruction::SUBLL)) {
+    first.instruction =
+        b == Instruction::ADDLL ? Instruction::INC : Instruction::DEC;
+    remove(second);
+    return true;
+  }
+
+  // a branch on a constant either never jumps or always does.
+  if (a == Instruction::PUSHB && b == Instruction::JF) {
+    if (first.b) {
+      remove(index);
+    } else {
+      first.instruction = Instruction::JMP;
+      first.address = ir.address;
+      retarget(index, ir.target);
+    }
+    remove(second);
+    return true;
+  }
+  return false;
+}
+
+// A jump to an unconditional jump can go straight to where that one goes.
+bool ripl::Optimizer::threadJump(int index) {
+  IrInstruction &ir = _program[index];
+  if (ir.target == -1) {
+    return false;
+  }
+  int target = resolve(ir.target);
+  if (target >= _program.size() || target == index) {
+    return false;
+  }
+  IrInstruction &jump = _program[target];
+  if (jump.instruction != Instruction::JMP || jump.target == -1 ||
+      resolve(jump.target) == target || jump.target == ir.target) {
+    return false;
+  }
+  retarget(index, jump.target);
+  return true;
+}
+
+// Adding a constant or a variable to a long, the operand of ADDLL is folded
+// into the instruction itself. A call right before a return becomes a tail
+// call, the subroutine returns straight to where this one would have.
+bool ripl::Optimizer::fuseAt(int index) {
+  IrInstruction &ir = _program[index];
+  int second = next(index);
+  if (second >= _program.size()) {
+    return false;
+  }
+  if (ir.instruction == Instruction::CALL &&
+      _program[second].instruction == Instruction::RET) {
+    ir.instruction = Instruction::TAILCALL;
+    // others may still return through it.
+    if (!isTarget(second)) {
+      remove(second);
+    }
+    return true;
+  }
+  if (isTarget(second)) {
+    return false;
+  }
+  Instruction b = _program[second].instruction;
+
+  if (ir.instruction == Instruction::PUSHL && b == Instruction::ADDLL) {
+    ir.instruction = Instruction::ADDL;
+  } else if (ir.instruction == Instruction::PUSHL && b == Instruction::SUBLL &&
+             ir.l != LONG_MIN) {
+    ir.instruction = Instruction::ADDL;
+    ir.l = -ir.l;
+  } else if (ir.instruction == Instruction::LOADSLOT &&
+             b == Instruction::ADDLL) {
+    ir.instruction = Instruction::ADDSLOTLL;
+  } else {
+    return false;
+  }
+  remove(second);
+  return true;
+}
+
+// Unlike the other passes this one adds instructions, so the program is
+// built up again as it goes. Jumps copied along with a body are relocated to
+// the copy, a return in the middle of it becomes a jump past its end. The
+// subroutines themselves stay where they are.
+int ripl::Optimizer::inlineCalls(int limit) {
+  std::vector<int> ends(_program.size(), -2); // entry -> bodyEnd, -2 unknown
+  std::vector<int> newIndex(_program.size() + 1, -1);
+  std::vector<IrInstruction> inlined;
+  std::vector<bool> relocated; // the target is already one into inlined
+  int replaced = 0;
+
+  for (int i = 0; i < _program.size(); i++) {
+    const IrInstruction &ir = _program[i];
+    newIndex[i] = inlined.size();
+    int entry = ir.target;
+    if (ir.instruction == Instruction::CALL && entry != -1 &&
+        ends[entry] == -2) {
+      ends[entry] = bodyEnd(entry, limit);
+    }
+    if (ir.instruction != Instruction::CALL || entry == -1 ||
+        ends[entry] == -1) {
+      inlined.push_back(ir);
+      relocated.push_back(false);
+      continue;
+    }
+
+    int start = inlined.size();
+    int end = ends[entry];
+    for (int j = entry; j < end; j++) {
+      IrInstruction copy = _program[j];
+      if (copy.instruction == Instruction::RET) {
+        copy.instruction = Instruction::JMP;
+        copy.target = end;
+      }
+      if (copy.isJump()) {
+        copy.target = start + copy.target - entry;
+      }
+      inlined.push_back(copy);
+      relocated.push_back(copy.isJump());
+    }
+    replaced++;
+  }
+  newIndex[_program.size()] = inlined.size();
+
+  for (int i = 0; i < inlined.size(); i++) {
+    if (!relocated[i] && inlined[i].target != -1) {
+      inlined[i].target = newIndex[inlined[i].target];
+    }
+  }
+  _program = inlined;
+  track();
+  return replaced;
+}
+
+// The return ending the subroutine at entry, the first one that no jump
+// before it goes past. -1 if the body is longer than limit, jumps out of
+// itself or calls itself.
+int ripl::Optimizer::bodyEnd(int entry, int limit) {
+  int reach = entry;
+  for (int i = entry; i < _program.size() && i - entry <= limit; i++) {
+    const IrInstruction &ir = _program[i];
+    if (ir.instruction == Instruction::RET && i >= reach) {
+      return i;
+    }
+    if ((ir.instruction == Instruction::CALL ||
+         ir.instruction == Instruction::TAILCALL) &&
+        ir.target == entry) {
+      return -1;
+    }
+    if (ir.isJump()) {
+      if (ir.target < entry) { // also -1, going nowhere
+        return -1;
+      }
+      reach = std::max(reach, ir.target);
+    }
+  }
+  return -1;
+}
+
+void ripl::Optimizer::compact() {
+  std::vector<int> newIndex(_program.size() + 1, -1);
+  std::vector<IrInstruction> compacted;
+  for (int i = 0; i < _program.size(); i++) {
+    if (!_removed[i]) {
+      newIndex[i] = compacted.size();
+      compacted.push_back(_program[i]);
+    }
+  }
+  newIndex[_program.size()] = compacted.size();
+
+  for (auto &ir : compacted) {
+    if (ir.target != -1) {
+      ir.target = newIndex[resolve(ir.target)];
+    }
+  }
+  _program = compacted;
+  track();
+}
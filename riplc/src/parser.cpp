@@ -1,140 +1,132 @@
 #include "parser.hpp"
+#include "keyword.hpp"
+#include "mapped_file.hpp"
 #include "token.hpp"
-#include "utils.hpp"
+#include <algorithm>
 #include <cctype>
-#include <fstream>
+#include <charconv>
 #include <iostream>
-#include <sstream>
-#include <string>
+#include <string_view>
 
-ripl::Parser::Parser(char *filename) {
-  std::ifstream in(filename);
-  std::stringstream buf;
+// isspace of the C locale, without the call.
+static bool isSpace(char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); }
 
-  if (!in.is_open()) {
+// true or false in any case.
+static bool isWord(std::string_view lexeme, std::string_view word) {
+  return std::ranges::equal(lexeme, word, [](char ch, char lower) {
+    return std::tolower((unsigned char)ch) == lower;
+  });
+}
+
+ripl::Parser::Parser(const char *filename) : _file(filename) {
+  if (!_file.isOpen()) {
     std::cerr << "Could not open the file " << filename
               << " for input.\nDid you specify the filename correctly?"
               << std::endl;
+    _failed = true;
     return;
   }
-  buf << in.rdbuf();
-
-  text = buf.str();
-  in.close();
+  _pos = _file.data();
+  _end = _pos + _file.length();
+  // every token takes at least a char and the white space after it, only
+  // the pages actually used are ever touched.
+  _tokens.reserve(_file.length() / 2 + 1);
 }
 
 ripl::Parser::~Parser() {}
 
-void ripl::Parser::build() {
-  char ch;
-
-  while (!_endOfText()) {
-    ch = _nextChar();
-    if (ch == '#') {
-      _discardComments();
-      continue;
-    }
-    if (ch == '\"') {
-      std::string s = _getQuotedString();
-      Token tok(TokenType::STRING, s, _line, _column);
-      _tokens.push_back(tok);
-      continue;
-    }
-    if (isspace(ch)) {
-      _skipWhiteSpaces();
+bool ripl::Parser::build() {
+  while (_pos < _end) {
+    char ch = *_pos;
+    if (ch == '\n') {
+      _line++;
+      _column = 1;
+      _pos++;
       continue;
     }
-    _unget();
-    std::string lexeme = _nextToken();
-    if (isIntegral(lexeme)) {
-      Token tok(TokenType::LONG, lexeme, _line, _column);
-      _tokens.push_back(tok);
+    if (isSpace(ch)) {
+      _column += ch == '\t' ? 8 : 1;
+      _pos++;
       continue;
     }
-    if (isFloat(lexeme)) {
-      Token tok(TokenType::DOUBLE, lexeme, _line, _column);
-      _tokens.push_back(tok);
+    if (ch == '#') {
+      _discardComment();
       continue;
     }
-    if (isBool(lexeme)) {
-      Token tok(TokenType::BOOL, lexeme, _line, _column);
-      _tokens.push_back(tok);
+    if (ch == '\"') {
+      _quotedString();
       continue;
     }
-    Token tok(TokenType::IDENTIFIER, lexeme, _line, _column);
-    _tokens.push_back(tok);
-    continue;
+    _word();
   }
+  return !_failed;
 }
 
-void ripl::Parser::_skipWhiteSpaces() {
-  char ch = _nextChar();
-  while (std::isspace(ch)) {
-    if (_endOfText()) {
-      break;
+// Anything up to the next white space. Digits with at most one point in them
+// are a number, a double if there is a point or they don't fit in a long.
+void ripl::Parser::_word() {
+  const char *start = _pos;
+  bool digits = true;
+  int points = 0;
+  for (; _pos < _end && !isSpace(*_pos); _pos++) {
+    if (*_pos == '.') {
+      points++;
+    } else if (*_pos < '0' || *_pos > '9') {
+      digits = false;
     }
-    ch = _nextChar();
   }
-  _unget();
-}
+  std::string_view lexeme(start, _pos - start);
+  Token token(TokenType::IDENTIFIER, lexeme, _line, _column);
+  _column += lexeme.size();
 
-std::string ripl::Parser::_nextToken() {
-  char ch = _nextChar();
-  std::string token = "";
-  while (!std::isspace(ch)) {
-    if (_endOfText()) {
-      break;
+  if (digits && points == 0 &&
+      std::from_chars(start, _pos, token.l).ec == std::errc()) {
+    token.type = TokenType::LONG;
+  } else if (digits && points <= 1 && (points == 0 || lexeme.size() > 1)) {
+    if (std::from_chars(start, _pos, token.d).ec != std::errc()) {
+      std::cerr << "The number " << lexeme << " on line " << token.line
+                << " is out of range." << std::endl;
+      _failed = true;
+      return;
     }
-    token += ch;
-    ch = _nextChar();
+    token.type = TokenType::DOUBLE;
+  } else if (isWord(lexeme, "true") || isWord(lexeme, "false")) {
+    token.type = TokenType::BOOL;
+    token.b = isWord(lexeme, "true");
+  } else {
+    token.keyword = keywordOf(lexeme);
   }
-  _unget();
-  return token;
+  _tokens.push_back(token);
 }
 
-std::string ripl::Parser::_getQuotedString() {
-  char ch;
-  std::string str = "";
-  while ((ch = _nextChar()) != '\"') {
-    if (_endOfText()) {
-      _unget();
-      std::cerr << "Reached End before encountering \" here: " << str
-                << std::endl;
-      break;
-    }
-    str += ch;
+// The string runs up to the next quote, there are no escapes.
+void ripl::Parser::_quotedString() {
+  int line = _line, column = _column;
+  const char *start = ++_pos;
+  auto quote = std::find(start, _end, '\"');
+  std::string_view lexeme(start, quote - start);
+  if (quote == _end) {
+    std::cerr << "Reached End before encountering \" here: " << lexeme
+              << std::endl;
+    _failed = true;
+    _pos = _end;
+  } else {
+    _pos = quote + 1;
   }
-  return str;
-}
-
-void ripl::Parser::_discardComments() {
-  char ch;
-  while ((ch = _nextChar()) != '\n') {
-    if (_endOfText()) {
-      _unget();
-      break;
+  for (char ch : lexeme) {
+    if (ch == '\n') {
+      _line++;
+      _column = 1;
+    } else {
+      _column += ch == '\t' ? 8 : 1;
     }
   }
+  _column += 2;
+  _tokens.emplace_back(TokenType::STRING, lexeme, line, column);
 }
 
-int ripl::Parser::_nextChar() {
-  int ch = text[_pos++];
-  if (ch == '\n') {
-    _line++;
-    _column = 0;
-  } else if (ch == '\t') {
-    _column += 8;
-  } else {
-    _column++;
-  }
-  _lastline = _line;
-  _lastcol = _column;
-
-  return ch;
-}
-
-void ripl::Parser::_unget() {
-  _pos--;
-  _column = _lastcol;
-  _line = _lastline;
+void ripl::Parser::_discardComment() {
+  auto newline = std::find(_pos, _end, '\n');
+  _column += newline - _pos;
+  _pos = newline;
 }
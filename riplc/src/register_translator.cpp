@@ -0,0 +1,551 @@
+#include "register_translator.hpp"
+#include "instruction_set.hpp"
+#include "ir.hpp"
+#include "register_set.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+// The register instruction doing what a binary stack instruction does.
+static ripl::RegisterInstruction counterpart(ripl::Instruction instruction) {
+  switch (instruction) {
+  case ripl::Instruction::ADD:
+    return ripl::RegisterInstruction::ADD;
+  case ripl::Instruction::SUB:
+    return ripl::RegisterInstruction::SUB;
+  case ripl::Instruction::MUL:
+    return ripl::RegisterInstruction::MUL;
+  case ripl::Instruction::DIV:
+    return ripl::RegisterInstruction::DIV;
+  case ripl::Instruction::MOD:
+    return ripl::RegisterInstruction::MOD;
+  case ripl::Instruction::AND:
+    return ripl::RegisterInstruction::AND;
+  case ripl::Instruction::OR:
+    return ripl::RegisterInstruction::OR;
+  case ripl::Instruction::EQ:
+    return ripl::RegisterInstruction::EQ;
+  case ripl::Instruction::NEQ:
+    return ripl::RegisterInstruction::NEQ;
+  case ripl::Instruction::GT:
+    return ripl::RegisterInstruction::GT;
+  case ripl::Instruction::LT:
+    return ripl::RegisterInstruction::LT;
+  case ripl::Instruction::GTE:
+    return ripl::RegisterInstruction::GTE;
+  case ripl::Instruction::LTE:
+    return ripl::RegisterInstruction::LTE;
+  case ripl::Instruction::ADDLL:
+    return ripl::RegisterInstruction::ADDLL;
+  case ripl::Instruction::ADDDD:
+    return ripl::RegisterInstruction::ADDDD;
+  case ripl::Instruction::SUBLL:
+    return ripl::RegisterInstruction::SUBLL;
+  case ripl::Instruction::SUBDD:
+    return ripl::RegisterInstruction::SUBDD;
+  case ripl::Instruction::MULLL:
+    return ripl::RegisterInstruction::MULLL;
+  case ripl::Instruction::MULDD:
+    return ripl::RegisterInstruction::MULDD;
+  case ripl::Instruction::DIVLL:
+    return ripl::RegisterInstruction::DIVLL;
+  case ripl::Instruction::DIVDD:
+    return ripl::RegisterInstruction::DIVDD;
+  case ripl::Instruction::CONCAT:
+    return ripl::RegisterInstruction::CONCAT;
+  case ripl::Instruction::EQLL:
+    return ripl::RegisterInstruction::EQLL;
+  case ripl::Instruction::NEQLL:
+    return ripl::RegisterInstruction::NEQLL;
+  case ripl::Instruction::GTLL:
+    return ripl::RegisterInstruction::GTLL;
+  case ripl::Instruction::LTLL:
+    return ripl::RegisterInstruction::LTLL;
+  case ripl::Instruction::GTELL:
+    return ripl::RegisterInstruction::GTELL;
+  case ripl::Instruction::LTELL:
+    return ripl::RegisterInstruction::LTELL;
+  default:
+    return ripl::RegisterInstruction::DEOPT;
+  }
+}
+
+ripl::RegisterTranslator::RegisterTranslator(
+    const std::vector<IrInstruction> &program, int slots)
+    : _program(program), _slots(slots) {}
+
+bool ripl::RegisterTranslator::translate() {
+  for (auto &ir : _program) {
+    // subroutines are left to the stack code, see CALL.
+    if (ir.isJump()) {
+      if (ir.target == -1) {
+        return fail("a jump at offset " + std::to_string(ir.offset) +
+                    " leads nowhere");
+      }
+      _targets.insert(ir.target);
+    }
+  }
+  for (_current = 0; _current < _program.size(); _current++) {
+    if (_targets.contains(_current) && !label(_current)) {
+      return false;
+    }
+    if (_known && !step(_program[_current])) {
+      return false;
+    }
+  }
+  if (number({Kind::SCRATCH, _scratch}) >
+      std::numeric_limits<unsigned short>::max()) {
+    return fail("the program needs too many registers");
+  }
+  return true;
+}
+
+bool ripl::RegisterTranslator::step(const IrInstruction &ir) {
+  int last = _last;
+  _last = -1;
+
+  switch (ir.instruction) {
+  case Instruction::NOP:
+  case Instruction::ID:
+    break;
+  case Instruction::PUSHL:
+    push(constant(RegisterInstruction::LOADL, ir.l));
+    break;
+  case Instruction::PUSHD: {
+    long bits;
+    std::memcpy(&bits, &ir.d, sizeof(bits));
+    push(constant(RegisterInstruction::LOADD, bits));
+  } break;
+  case Instruction::PUSHB:
+    push(constant(RegisterInstruction::LOADB, ir.b));
+    break;
+  case Instruction::PUSHS:
+    push(constant(RegisterInstruction::LOADS, ir.constant));
+    break;
+  case Instruction::LOADSLOT:
+    push({Kind::VARIABLE, ir.slot});
+    break;
+  case Instruction::STORESLOT:
+    if (!need(1)) {
+      return false;
+    }
+    store(ir.slot, last);
+    break;
+  case Instruction::DUP:
+    if (!need(1)) {
+      return false;
+    }
+    push(_stack.back());
+    break;
+  case Instruction::DROP:
+    if (!need(1)) {
+      return false;
+    }
+    pop();
+    break;
+  case Instruction::SWAP:
+    if (!need(2)) {
+      return false;
+    }
+    std::swap(_stack[_stack.size() - 1], _stack[_stack.size() - 2]);
+    break;
+  case Instruction::ROTUP: // a b c -> c a b
+    if (!need(3)) {
+      return false;
+    }
+    std::rotate(_stack.end() - 3, _stack.end() - 1, _stack.end());
+    break;
+  case Instruction::ROTDN: // a b c -> b c a
+    if (!need(3)) {
+      return false;
+    }
+    std::rotate(_stack.end() - 3, _stack.end() - 2, _stack.end());
+    break;
+  case Instruction::ADD:
+  case Instruction::SUB:
+  case Instruction::MUL:
+  case Instruction::DIV:
+  case Instruction::MOD:
+  case Instruction::AND:
+  case Instruction::OR:
+  case Instruction::EQ:
+  case Instruction::NEQ:
+  case Instruction::GT:
+  case Instruction::LT:
+  case Instruction::GTE:
+  case Instruction::LTE:
+  case Instruction::ADDLL:
+  case Instruction::ADDDD:
+  case Instruction::SUBLL:
+  case Instruction::SUBDD:
+  case Instruction::MULLL:
+  case Instruction::MULDD:
+  case Instruction::DIVLL:
+  case Instruction::DIVDD:
+  case Instruction::CONCAT:
+  case Instruction::EQLL:
+  case Instruction::NEQLL:
+  case Instruction::GTLL:
+  case Instruction::LTLL:
+  case Instruction::GTELL:
+  case Instruction::LTELL: {
+    if (!need(2)) {
+      return false;
+    }
+    bool mayLeave =
+        ir.instruction >= Instruction::ADD && ir.instruction <= Instruction::OR;
+    binary(counterpart(ir.instruction), mayLeave);
+  } break;
+  case Instruction::ADDL:
+    if (!need(1)) {
+      return false;
+    }
+    push(constant(RegisterInstruction::LOADL, ir.l));
+    binary(RegisterInstruction::ADDLL, false);
+    break;
+  case Instruction::ADDSLOTLL:
+    if (!need(1)) {
+      return false;
+    }
+    push({Kind::VARIABLE, ir.slot});
+    binary(RegisterInstruction::ADDLL, false);
+    break;
+  case Instruction::NOT:
+    if (!need(1)) {
+      return false;
+    }
+    unary(RegisterInstruction::NOT, true);
+    break;
+  case Instruction::INC:
+  case Instruction::DEC:
+    if (!need(1)) {
+      return false;
+    }
+    unary(ir.instruction == Instruction::INC ? RegisterInstruction::INC
+                                             : RegisterInstruction::DEC,
+          false);
+    break;
+  case Instruction::JMP:
+    flush();
+    if (!reach(ir.target)) {
+      return false;
+    }
+    emit(RegisterInstruction::JMP, {}, 0, ir.target);
+    _known = false;
+    break;
+  // The conditional jumps leave when the value isn't of the type they test,
+  // only then is the depth of the stack not the same.
+  case Instruction::JZ:
+  case Instruction::JF:
+  case Instruction::DUPJZ:
+  case Instruction::DECJNZ: {
+    if (!need(1)) {
+      return false;
+    }
+    flush();
+    _deopts.push_back({(int)_code.size(), ir.offset, _stack});
+    Register top = _stack.back();
+    if (ir.instruction == Instruction::JZ ||
+        ir.instruction == Instruction::JF) {
+      pop();
+    }
+    if (!reach(ir.target)) {
+      return false;
+    }
+    emit(ir.instruction == Instruction::JF       ? RegisterInstruction::JF
+         : ir.instruction == Instruction::DECJNZ ? RegisterInstruction::DECJNZ
+                                                 : RegisterInstruction::JZ,
+         {top}, 0, ir.target);
+  } break;
+  case Instruction::EXPECT: {
+    Register top = {Kind::STACK, (int)_stack.size()};
+    materialize(top);
+    _last = emit(RegisterInstruction::EXPECT, {top});
+    push(top);
+  } break;
+  case Instruction::PRINT:
+    if (!need(1)) {
+      return false;
+    }
+    emit(RegisterInstruction::PRINT, {pop()});
+    break;
+  case Instruction::END:
+    emit(RegisterInstruction::END, {}, _stack.size());
+    _known = false;
+    break;
+  case Instruction::HALT:
+    emit(RegisterInstruction::HALT, {});
+    _known = false;
+    break;
+  default: // CALL, TAILCALL, RET and whatever is left to the stack code
+    leave();
+    break;
+  }
+  return true;
+}
+
+// Where control flow meets the values have to be in the registers of their
+// positions. A target only reached from code that isn't translated is left
+// out as well.
+bool ripl::RegisterTranslator::label(int index) {
+  if (_known) {
+    flush();
+    if (!reach(index)) {
+      return false;
+    }
+  } else if (_depths.contains(index)) {
+    _known = true;
+    _stack.clear();
+    for (int i = 0; i < _depths[index]; i++) {
+      _stack.push_back({Kind::STACK, i});
+    }
+  } else {
+    return true;
+  }
+  _labels[index] = _code.size();
+  _last = -1;
+  return true;
+}
+
+// The stack has to be just as deep however the target is reached.
+bool ripl::RegisterTranslator::reach(int target) {
+  auto [itr, inserted] = _depths.insert({target, (int)_stack.size()});
+  if (!inserted && itr->second != _stack.size()) {
+    return fail("the depth of the stack differs at offset " +
+                std::to_string(_program[target].offset));
+  }
+  if (target < _current && !_labels.contains(target)) {
+    return fail("a jump at offset " +
+                std::to_string(_program[_current].offset) +
+                " leads back into code that isn't translated");
+  }
+  return true;
+}
+
+bool ripl::RegisterTranslator::fail(const std::string &reason) {
+  _error = reason;
+  return false;
+}
+
+bool ripl::RegisterTranslator::need(int count) {
+  if (_stack.size() < count) {
+    return fail("the stack runs empty at offset " +
+                std::to_string(_program[_current].offset));
+  }
+  return true;
+}
+
+// Every distinct constant gets a register of its own, loaded once at the
+// start.
+ripl::RegisterTranslator::Register
+ripl::RegisterTranslator::constant(RegisterInstruction load, long bits) {
+  auto [itr, inserted] =
+      _constantIndex.insert({{load, bits}, (int)_constants.size()});
+  Register reg = {Kind::CONSTANT, itr->second};
+  if (inserted) {
+    _constants.push_back({load, {reg}, bits});
+  }
+  return reg;
+}
+
+void ripl::RegisterTranslator::push(Register reg) {
+  _stack.push_back(reg);
+  _maxDepth = std::max(_maxDepth, (int)_stack.size());
+}
+
+ripl::RegisterTranslator::Register ripl::RegisterTranslator::pop() {
+  Register reg = _stack.back();
+  _stack.pop_back();
+  return reg;
+}
+
+// The result goes into the register of the position of the left hand side.
+// Instructions that may leave record the stack as it is before they run.
+void ripl::RegisterTranslator::binary(RegisterInstruction instruction,
+                                      bool mayLeave) {
+  std::vector<Register> before = _stack;
+  Register rhs = pop();
+  Register lhs = pop();
+  Register result = {Kind::STACK, (int)_stack.size()};
+  materialize(result);
+  if (mayLeave) {
+    _deopts.push_back({(int)_code.size(), _program[_current].offset, before});
+  }
+  _last = emit(instruction, {result, lhs, rhs});
+  push(result);
+}
+
+void ripl::RegisterTranslator::unary(RegisterInstruction instruction,
+                                     bool mayLeave) {
+  std::vector<Register> before = _stack;
+  Register operand = pop();
+  Register result = {Kind::STACK, (int)_stack.size()};
+  materialize(result);
+  if (mayLeave) {
+    _deopts.push_back({(int)_code.size(), _program[_current].offset, before});
+  }
+  _last = emit(instruction, {result, operand});
+  push(result);
+}
+
+// A result that was only just computed into the register of the top of the
+// stack is put straight into the variable instead.
+void ripl::RegisterTranslator::store(int slot, int last) {
+  Register value = pop();
+  Register variable = {Kind::VARIABLE, slot};
+  if (value == variable) {
+    return;
+  }
+  bool aliased = std::find(_stack.begin(), _stack.end(), variable) !=
+                     _stack.end() ||
+                 std::find(_stack.begin(), _stack.end(), value) != _stack.end();
+  if (last != -1 && value == Register{Kind::STACK, (int)_stack.size()} &&
+      _code[last].registers[0] == value && !aliased) {
+    _code[last].registers[0] = variable;
+    return;
+  }
+  materialize(variable);
+  emit(RegisterInstruction::MOV, {variable, value});
+}
+
+// Values on the stack still held by a register about to be written are moved
+// out of the way first, into a register nothing else uses.
+void ripl::RegisterTranslator::materialize(Register reg) {
+  Register scratch = {Kind::SCRATCH, -1};
+  for (auto &entry : _stack) {
+    if (entry == reg) {
+      if (scratch.index == -1) {
+        scratch.index = _scratch++;
+        emit(RegisterInstruction::MOV, {scratch, reg});
+      }
+      entry = scratch;
+    }
+  }
+}
+
+// Moves every value into the register of its position. Values held by the
+// register of another position that is about to be written are saved first
+// so nothing gets overwritten before it is moved.
+void ripl::RegisterTranslator::flush() {
+  std::vector<bool> written;
+  for (int i = 0; i < _stack.size(); i++) {
+    written.push_back(_stack[i] != Register{Kind::STACK, i});
+  }
+  std::map<int, Register> saved;
+  for (int i = 0; i < _stack.size(); i++) {
+    Register &entry = _stack[i];
+    if (entry.kind != Kind::STACK || entry.index == i ||
+        entry.index >= written.size() || !written[entry.index]) {
+      continue;
+    }
+    if (!saved.contains(entry.index)) {
+      Register scratch = {Kind::SCRATCH, _scratch++};
+      emit(RegisterInstruction::MOV, {scratch, entry});
+      saved[entry.index] = scratch;
+    }
+    entry = saved[entry.index];
+  }
+  for (int i = 0; i < _stack.size(); i++) {
+    Register position = {Kind::STACK, i};
+    if (_stack[i] != position) {
+      emit(RegisterInstruction::MOV, {position, _stack[i]});
+      _stack[i] = position;
+    }
+  }
+  _last = -1;
+}
+
+// The stack code takes over for good from here on.
+void ripl::RegisterTranslator::leave() {
+  _deopts.push_back({(int)_code.size(), _program[_current].offset, _stack});
+  emit(RegisterInstruction::DEOPT, {});
+  _known = false;
+}
+
+int ripl::RegisterTranslator::emit(RegisterInstruction instruction,
+                                   std::vector<Register> registers, long bits,
+                                   int target) {
+  _code.push_back({instruction, registers, bits, target});
+  return _code.size() - 1;
+}
+
+// The variables come first so their registers are their slots, followed by
+// the constants, the stack positions and the scratch registers.
+int ripl::RegisterTranslator::number(Register reg) {
+  switch (reg.kind) {
+  case Kind::VARIABLE:
+    return reg.index;
+  case Kind::CONSTANT:
+    return _slots + reg.index;
+  case Kind::STACK:
+    return _slots + _constants.size() + reg.index;
+  default:
+    return _slots + _constants.size() + _maxDepth + reg.index;
+  }
+}
+
+std::string ripl::RegisterTranslator::section() {
+  std::vector<Op> ops = _constants;
+  ops.insert(ops.end(), _code.begin(), _code.end());
+  std::vector<int> positions;
+  int position = 0;
+  for (auto &op : ops) {
+    positions.push_back(position);
+    position += sizeOf(op.instruction);
+  }
+  positions.push_back(position);
+  auto at = [&](int op) { return positions[_constants.size() + op]; };
+
+  std::string code;
+  auto append = [&](const auto &value) {
+    code.append((const char *)&value, sizeof(value));
+  };
+  for (auto &op : ops) {
+    code.push_back((char)op.instruction);
+    for (auto reg : op.registers) {
+      append((unsigned short)number(reg));
+    }
+    switch (op.instruction) {
+    case RegisterInstruction::LOADL:
+    case RegisterInstruction::LOADD:
+      append(op.bits);
+      break;
+    case RegisterInstruction::LOADB:
+      append((bool)op.bits);
+      break;
+    case RegisterInstruction::LOADS:
+    case RegisterInstruction::END:
+      append((int)op.bits);
+      break;
+    case RegisterInstruction::JMP:
+    case RegisterInstruction::JZ:
+    case RegisterInstruction::JF:
+    case RegisterInstruction::DECJNZ:
+      append(at(_labels[op.target]));
+      break;
+    default:
+      break;
+    }
+  }
+
+  std::string section;
+  auto appendTo = [&](const auto &value) {
+    section.append((const char *)&value, sizeof(value));
+  };
+  appendTo(number({Kind::SCRATCH, _scratch}));
+  appendTo((int)code.length());
+  section += code;
+  appendTo((int)_deopts.size());
+  for (auto &deopt : _deopts) {
+    appendTo(at(deopt.op));
+    appendTo(deopt.offset);
+    appendTo((int)deopt.stack.size());
+    for (auto reg : deopt.stack) {
+      appendTo((unsigned short)number(reg));
+    }
+  }
+  return section;
+}
@@ -1,27 +1,24 @@
 #include "stack_frame.hpp"
 #include <iostream>
 
-void ripl::StackFrame::addToBreaks(int offset) {
+int ripl::StackFrame::breakLabel() {
   if (_loopLevel == 0) {
     std::cerr << "No loops to break out of." << std::endl;
-    return;
+    return -1;
   }
   if (_branchType == BranchType::LOOPING) {
-    _breaks.push_back(offset);
-    return;
+    return _exit;
   }
-  _parent->addToBreaks(offset);
+  return _parent->breakLabel();
 }
 
-void ripl::StackFrame::addToContinues(int offset) {
+int ripl::StackFrame::continueLabel() {
   if (_loopLevel == 0) {
     std::cerr << "No loops to continue." << std::endl;
-    return;
+    return -1;
   }
   if (_branchType == BranchType::LOOPING) {
-    _continues.push_back(offset);
-    return;
+    return _next;
   }
-  _parent->addToContinues(offset);
+  return _parent->continueLabel();
 }
-
@@ -0,0 +1,372 @@
+#include "type_inference.hpp"
+#include "instruction_set.hpp"
+#include "ir.hpp"
+#include <algorithm>
+#include <map>
+#include <vector>
+
+static ripl::StaticType join(ripl::StaticType a, ripl::StaticType b) {
+  if (a == ripl::StaticType::NONE) {
+    return b;
+  }
+  if (b == ripl::StaticType::NONE) {
+    return a;
+  }
+  return a == b ? a : ripl::StaticType::UNKNOWN;
+}
+
+static bool isNumeric(ripl::StaticType type) {
+  return type == ripl::StaticType::LONG || type == ripl::StaticType::DOUBLE;
+}
+
+static ripl::StaticType pop(std::vector<ripl::StaticType> &types) {
+  if (types.empty()) {
+    return ripl::StaticType::UNKNOWN;
+  }
+  auto type = types.back();
+  types.pop_back();
+  return type;
+}
+
+static ripl::StaticType top(std::vector<ripl::StaticType> &types) {
+  return types.empty() ? ripl::StaticType::UNKNOWN : types.back();
+}
+
+// Whether the top count values are all known to be of type.
+static bool provenAs(const std::vector<ripl::StaticType> &types,
+                     ripl::StaticType type, int count) {
+  return types.size() >= count &&
+         std::all_of(types.end() - count, types.end(),
+                     [type](ripl::StaticType other) { return other == type; });
+}
+
+// The result type of ADD, SUB, MUL and DIV following the promotion rules of
+// the engine.
+static ripl::StaticType arithmetic(ripl::Instruction instruction,
+                                   ripl::StaticType lhs, ripl::StaticType rhs) {
+  using ripl::StaticType;
+  if (lhs == StaticType::NONE || rhs == StaticType::NONE) {
+    return StaticType::NONE;
+  }
+  if (lhs == StaticType::LONG && rhs == StaticType::LONG) {
+    return instruction == ripl::Instruction::DIV ? StaticType::DOUBLE
+                                                 : StaticType::LONG;
+  }
+  if (isNumeric(lhs) && isNumeric(rhs)) {
+    return StaticType::DOUBLE;
+  }
+  if (instruction == ripl::Instruction::ADD &&
+      (lhs == StaticType::STRING || rhs == StaticType::STRING) &&
+      (lhs == StaticType::STRING || isNumeric(lhs)) &&
+      (rhs == StaticType::STRING || isNumeric(rhs))) {
+    return StaticType::STRING;
+  }
+  return StaticType::UNKNOWN;
+}
+
+ripl::TypeInference::TypeInference(std::vector<IrInstruction> &program)
+    : _program(program) {
+  for (int i = 0; i < _program.size(); i++) {
+    // every variable starts out as a long 0 before anything is assigned.
+    if (_program[i].slot != -1) {
+      _variables[_program[i].slot] = StaticType::LONG;
+    }
+  }
+}
+
+int ripl::TypeInference::specialize() {
+  // variable types only ever grow, so keep going until they settle.
+  std::map<int, StaticType> before;
+  do {
+    before = _variables;
+    analyse();
+  } while (before != _variables);
+
+  int count = 0;
+  for (int i = 0; i < _program.size(); i++) {
+    if (!_reached[i]) {
+      continue;
+    }
+    Instruction instruction = specialized(_program[i], _states[i]);
+    if (instruction != _program[i].instruction) {
+      _program[i].instruction = instruction;
+      count++;
+    }
+  }
+  return count;
+}
+
+void ripl::TypeInference::analyse() {
+  _states.assign(_program.size(), TypeStack());
+  _reached.assign(_program.size(), false);
+
+  std::vector<int> worklist;
+  if (!_program.empty()) {
+    flow(0, TypeStack(), worklist);
+  }
+
+  while (!worklist.empty()) {
+    int index = worklist.back();
+    worklist.pop_back();
+
+    const IrInstruction &ir = _program[index];
+    TypeStack types = _states[index];
+    bool fallsThrough = transfer(ir, types);
+
+    if (ir.isJump() && ir.target != -1) {
+      flow(ir.target, types, worklist);
+    }
+    // nothing is known about the stack on entry to a subroutine.
+    if ((ir.instruction == Instruction::CALL ||
+         ir.instruction == Instruction::TAILCALL) &&
+        ir.target != -1) {
+      flow(ir.target, TypeStack(), worklist);
+    }
+    if (fallsThrough && index + 1 < _program.size()) {
+      flow(index + 1, types, worklist);
+    }
+  }
+}
+
+// Merges the incoming state into the one already recorded for the
+// instruction, queueing it up again if anything changed. Only as much of the
+// top of the two stacks as both have in common is kept.
+void ripl::TypeInference::flow(int index, const TypeStack &state,
+                               std::vector<int> &worklist) {
+  if (!_reached[index]) {
+    _reached[index] = true;
+    _states[index] = state;
+    worklist.push_back(index);
+    return;
+  }
+
+  TypeStack &current = _states[index];
+  int depth = std::min(current.size(), state.size());
+  TypeStack merged(current.end() - depth, current.end());
+  for (int i = 0; i < depth; i++) {
+    merged[i] = join(merged[i], state[state.size() - depth + i]);
+  }
+  if (merged != current) {
+    current = merged;
+    worklist.push_back(index);
+  }
+}
+
+// Applies the effect of one instruction to the stack types, returns false if
+// control never continues with the next instruction.
+bool ripl::TypeInference::transfer(const IrInstruction &ir, TypeStack &types) {
+  switch (ir.instruction) {
+  case Instruction::PUSHL:
+    types.push_back(StaticType::LONG);
+    break;
+  case Instruction::PUSHD:
+    types.push_back(StaticType::DOUBLE);
+    break;
+  case Instruction::PUSHB:
+    types.push_back(StaticType::BOOL);
+    break;
+  case Instruction::PUSHS:
+    types.push_back(StaticType::STRING);
+    break;
+  // these leave their operands in place when the engine finds them to be of
+  // the wrong type, unless that is ruled out nothing is known any more.
+  case Instruction::ADD:
+  case Instruction::SUB:
+  case Instruction::MUL:
+  case Instruction::DIV: {
+    auto rhs = pop(types);
+    auto lhs = pop(types);
+    auto result = arithmetic(ir.instruction, lhs, rhs);
+    if (result == StaticType::UNKNOWN || result == StaticType::NONE) {
+      types.clear();
+      break;
+    }
+    types.push_back(result);
+  } break;
+  case Instruction::MOD:
+    if (!provenAs(types, StaticType::LONG, 2)) {
+      types.clear();
+      break;
+    }
+    [[fallthrough]];
+  case Instruction::ADDLL:
+  case Instruction::SUBLL:
+  case Instruction::MULLL:
+    pop(types);
+    pop(types);
+    types.push_back(StaticType::LONG);
+    break;
+  case Instruction::ADDDD:
+  case Instruction::SUBDD:
+  case Instruction::MULDD:
+  case Instruction::DIVDD:
+  case Instruction::DIVLL:
+    pop(types);
+    pop(types);
+    types.push_back(StaticType::DOUBLE);
+    break;
+  case Instruction::CONCAT:
+    pop(types);
+    pop(types);
+    types.push_back(StaticType::STRING);
+    break;
+  case Instruction::AND:
+  case Instruction::OR:
+    if (!provenAs(types, StaticType::BOOL, 2)) {
+      types.clear();
+      break;
+    }
+    [[fallthrough]];
+  case Instruction::EQ:
+  case Instruction::NEQ:
+  case Instruction::GT:
+  case Instruction::LT:
+  case Instruction::GTE:
+  case Instruction::LTE:
+  case Instruction::EQLL:
+  case Instruction::NEQLL:
+  case Instruction::GTLL:
+  case Instruction::LTLL:
+  case Instruction::GTELL:
+  case Instruction::LTELL:
+    pop(types);
+    pop(types);
+    types.push_back(StaticType::BOOL);
+    break;
+  case Instruction::NOT:
+    if (!provenAs(types, StaticType::BOOL, 1)) {
+      types.clear();
+      break;
+    }
+    pop(types);
+    types.push_back(StaticType::BOOL);
+    break;
+  // the conditional jumps only consume a value of the type they test, if
+  // that isn't known neither is whether anything was consumed.
+  case Instruction::JZ:
+  case Instruction::JF: {
+    auto tested = ir.instruction == Instruction::JZ ? StaticType::LONG
+                                                    : StaticType::BOOL;
+    auto type = top(types);
+    if (type == tested) {
+      pop(types);
+    } else if (type == StaticType::UNKNOWN || type == StaticType::NONE) {
+      types.clear();
+    }
+  } break;
+  // these leave the counter in place, a copy is pushed if it isn't a long.
+  case Instruction::DUPJZ:
+  case Instruction::DECJNZ: {
+    auto type = top(types);
+    if (type == StaticType::UNKNOWN || type == StaticType::NONE) {
+      types.clear();
+    } else if (type != StaticType::LONG) {
+      types.push_back(type);
+    }
+  } break;
+  case Instruction::JMP:
+    return false;
+  case Instruction::STORESLOT:
+    assign(ir.slot, pop(types));
+    break;
+  case Instruction::LOADSLOT:
+    types.push_back(_variables[ir.slot]);
+    break;
+  case Instruction::CALL:
+    types.clear(); // the subroutine may have done anything to the stack
+    break;
+  case Instruction::TAILCALL:
+  case Instruction::RET:
+    return false;
+  case Instruction::DUP:
+    types.push_back(top(types));
+    break;
+  case Instruction::SWAP: {
+    auto first = pop(types);
+    auto second = pop(types);
+    types.push_back(first);
+    types.push_back(second);
+  } break;
+  case Instruction::ROTUP: {
+    auto c = pop(types);
+    auto b = pop(types);
+    auto a = pop(types);
+    types.push_back(c);
+    types.push_back(a);
+    types.push_back(b);
+  } break;
+  case Instruction::ROTDN: {
+    auto c = pop(types);
+    auto b = pop(types);
+    auto a = pop(types);
+    types.push_back(b);
+    types.push_back(c);
+    types.push_back(a);
+  } break;
+  case Instruction::DROP:
+  case Instruction::PRINT:
+    pop(types);
+    break;
+  case Instruction::EXPECT:
+    types.push_back(StaticType::UNKNOWN);
+    break;
+  case Instruction::END:
+  case Instruction::HALT:
+    return false;
+  default:
+    break;
+  }
+  return true;
+}
+
+void ripl::TypeInference::assign(int slot, StaticType type) {
+  _variables[slot] = join(_variables[slot], type);
+}
+
+ripl::Instruction ripl::TypeInference::specialized(const IrInstruction &ir,
+                                                   const TypeStack &types) {
+  if (types.size() < 2) {
+    return ir.instruction;
+  }
+  StaticType lhs = types[types.size() - 2];
+  StaticType rhs = types[types.size() - 1];
+  bool longs = lhs == StaticType::LONG && rhs == StaticType::LONG;
+  bool doubles = lhs == StaticType::DOUBLE && rhs == StaticType::DOUBLE;
+  bool strings = lhs == StaticType::STRING && rhs == StaticType::STRING;
+
+  switch (ir.instruction) {
+  case Instruction::ADD:
+    if (strings) {
+      return Instruction::CONCAT;
+    }
+    return longs     ? Instruction::ADDLL
+           : doubles ? Instruction::ADDDD
+                     : ir.instruction;
+  case Instruction::SUB:
+    return longs     ? Instruction::SUBLL
+           : doubles ? Instruction::SUBDD
+                     : ir.instruction;
+  case Instruction::MUL:
+    return longs     ? Instruction::MULLL
+           : doubles ? Instruction::MULDD
+                     : ir.instruction;
+  case Instruction::DIV:
+    return longs     ? Instruction::DIVLL
+           : doubles ? Instruction::DIVDD
+                     : ir.instruction;
+  case Instruction::EQ:
+    return longs ? Instruction::EQLL : ir.instruction;
+  case Instruction::NEQ:
+    return longs ? Instruction::NEQLL : ir.instruction;
+  case Instruction::GT:
+    return longs ? Instruction::GTLL : ir.instruction;
+  case Instruction::LT:
+    return longs ? Instruction::LTLL : ir.instruction;
+  case Instruction::GTE:
+    return longs ? Instruction::GTELL : ir.instruction;
+  case Instruction::LTE:
+    return longs ? Instruction::LTELL : ir.instruction;
+  default:
+    return ir.instruction;
+  }
+}
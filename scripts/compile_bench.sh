@@ -0,0 +1,31 @@
+#!/bin/sh
+# Generates a large script and reports how long riplc takes to compile it.
+# Every line is mostly keywords and operators, many of them ones that used to
+# be compared against last (while, endwhile, break, continue), so the time
+# goes into lexing and recognising identifiers rather than the passes. Each
+# block also has a handful of branches and calls a subroutine defined after
+# the end, so there are plenty of jumps and calls for the compiler to link.
+#
+# usage: compile_bench.sh path/to/riplc [blocks]   (6 lines per block)
+riplc=${1:?usage: compile_bench.sh path/to/riplc [blocks]}
+blocks=${2:-200000}
+script=${TMPDIR:-/tmp}/compile_bench.rpn
+
+awk -v blocks="$blocks" 'BEGIN {
+  print "i var"
+  print "n var"
+  for (b = 0; b < blocks; b++) {
+    print "# block " b
+    print "i -> n -> <= while i -> ++ i <- i -> 2 % 0 == if continue endif"
+    print "n -> i -> >= if break endif endwhile"
+    print "i -> n -> dup rotup rotdn swap drop && n -> || ! n -> != drop"
+    print "expect n <- n -> 3 > if n -> = else i -> = endif s" b " call"
+  }
+  print "end"
+  for (b = 0; b < blocks; b++) {
+    print "s" b " { i -> 1 + i <- s" (b + 1) % blocks " call }"
+  }
+}' > "$script"
+
+"$riplc" --stats "$script"
+rm -f "$script" "$script.bc"